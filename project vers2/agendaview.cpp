@@ -0,0 +1,228 @@
+#include "agendaview.h"
+#include "eventstore.h"
+#include <QPainter>
+#include <QScrollBar>
+#include <QMouseEvent>
+#include <QLocale>
+#include <algorithm>
+
+namespace {
+    const int kRangeDays = 366;        // Год ленты
+    const int kDaysBefore = 183;       // Из них до опорной даты
+    const int kHeaderHeight = 26;
+    const int kRowHeight = 24;
+    const int kMaxCachedDays = 256;    // Дни с уже запрошенными событиями
+}
+
+AgendaView::AgendaView(QWidget* parent)
+    : QAbstractScrollArea(parent)
+    , m_store(nullptr)
+    , m_source(Event::Local)
+    , m_rangeStart(QDate::currentDate().addDays(-kDaysBefore))
+    , m_dirty(true)
+{
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    verticalScrollBar()->setSingleStep(kRowHeight);
+}
+
+void AgendaView::setEventStore(const EventStore* store)
+{
+    m_store = store;
+    invalidate();
+}
+
+bool AgendaView::setEventSource(Event::Source source)
+{
+    if (m_source == source) return false;
+    m_source = source;
+    return true;
+}
+
+// Лента перестраивается вокруг даты, если та вышла за её пределы
+void AgendaView::setAnchorDate(const QDate& date)
+{
+    if (!date.isValid()) return;
+    if (date < m_rangeStart.addDays(30) || date >= m_rangeStart.addDays(kRangeDays - 30)) {
+        m_rangeStart = date.addDays(-kDaysBefore);
+        invalidate();
+    }
+    scrollToDate(date);
+}
+
+void AgendaView::scrollToDate(const QDate& date)
+{
+    ensureCounts();
+    updateScrollBars();
+
+    // Первый день с событиями, начиная с указанного
+    int day = int(qBound<qint64>(0, m_rangeStart.daysTo(date), kRangeDays));
+    verticalScrollBar()->setValue(m_dayOffsets[day]);
+}
+
+void AgendaView::invalidate()
+{
+    m_dirty = true;
+    m_dayEvents.clear();
+    viewport()->update();
+}
+
+// Изменения за пределами ленты её не трогают
+void AgendaView::invalidateDays(const QDate& from, const QDate& to)
+{
+    if ((!to.isValid() || to >= m_rangeStart)
+        && (!from.isValid() || from < m_rangeStart.addDays(kRangeDays))) {
+        invalidate();
+    }
+}
+
+//-==========================-
+// Число событий по дням года - один запрос диапазона
+//-==========================-
+void AgendaView::ensureCounts()
+{
+    if (!m_dirty) return;
+    m_dirty = false;
+
+    m_dayCounts.fill(0, kRangeDays);
+    if (m_store) {
+        const QDate rangeEnd = m_rangeStart.addDays(kRangeDays);
+        for (const Event& event : m_store->eventsInRange(m_rangeStart.startOfDay(),
+            rangeEnd.startOfDay(), m_source)) {
+            if (!event.start().isValid()) continue;
+
+            // Дни, которые событие пересекает (как в EventStore::eventsForDate)
+            const QDate last = event.end() > event.start()
+                ? event.end().addMSecs(-1).date() : event.start().date();
+            const qint64 first = qMax<qint64>(0, m_rangeStart.daysTo(event.start().date()));
+            const qint64 end = qMin<qint64>(kRangeDays - 1, m_rangeStart.daysTo(last));
+            for (qint64 day = first; day <= end; ++day) {
+                ++m_dayCounts[int(day)];
+            }
+        }
+    }
+
+    // Пустые дни в ленте не показываются
+    m_dayOffsets.resize(kRangeDays + 1);
+    int y = 0;
+    for (int day = 0; day < kRangeDays; ++day) {
+        m_dayOffsets[day] = y;
+        if (m_dayCounts[day] > 0) {
+            y += kHeaderHeight + m_dayCounts[day] * kRowHeight;
+        }
+    }
+    m_dayOffsets[kRangeDays] = y;
+    updateScrollBars();
+}
+
+const QVector<Event>& AgendaView::eventsForDay(const QDate& date) const
+{
+    auto it = m_dayEvents.find(date);
+    if (it != m_dayEvents.end()) return it.value();
+
+    if (m_dayEvents.size() >= kMaxCachedDays) {
+        m_dayEvents.clear();
+    }
+    QVector<Event> events = m_store ? m_store->eventsForDate(date, m_source) : QVector<Event>();
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+        return a.start() < b.start();
+        });
+    return m_dayEvents.insert(date, events).value();
+}
+
+// Индекс дня, чей блок содержит координату y
+int AgendaView::dayAt(int y) const
+{
+    auto it = std::upper_bound(m_dayOffsets.constBegin(), m_dayOffsets.constEnd() - 1, y);
+    return qMax(0, int(it - m_dayOffsets.constBegin()) - 1);
+}
+
+void AgendaView::updateScrollBars()
+{
+    const int total = m_dayOffsets.isEmpty() ? 0 : m_dayOffsets.last();
+    verticalScrollBar()->setPageStep(viewport()->height());
+    verticalScrollBar()->setRange(0, qMax(0, total - viewport()->height()));
+}
+
+void AgendaView::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void AgendaView::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+    viewport()->update();
+}
+
+//-==========================-
+// Отрисовка только дней, попавших в окно
+//-==========================-
+void AgendaView::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
+    ensureCounts();
+
+    QPainter p(viewport());
+    const QPalette& pal = palette();
+    p.fillRect(viewport()->rect(), pal.color(QPalette::Base));
+
+    if (m_dayOffsets.last() == 0) {
+        p.setPen(pal.color(QPalette::PlaceholderText));
+        p.drawText(viewport()->rect(), Qt::AlignCenter, "Нет событий");
+        return;
+    }
+
+    const int scrollY = verticalScrollBar()->value();
+    const int width = viewport()->width();
+    const QDate today = QDate::currentDate();
+    const QLocale locale;
+    QFont headerFont = font();
+    headerFont.setBold(true);
+    const QFontMetrics metrics(font());
+
+    for (int day = dayAt(scrollY); day < kRangeDays; ++day) {
+        const int top = m_dayOffsets[day] - scrollY;
+        if (top >= viewport()->height()) break;
+        if (m_dayCounts[day] == 0) continue;
+
+        // Заголовок дня
+        const QDate date = m_rangeStart.addDays(day);
+        p.fillRect(QRect(0, top, width, kHeaderHeight),
+            date == today ? pal.color(QPalette::Highlight).lighter(170) : pal.color(QPalette::AlternateBase));
+        p.setFont(headerFont);
+        p.setPen(pal.color(QPalette::Text));
+        p.drawText(QRect(8, top, width - 16, kHeaderHeight), Qt::AlignVCenter | Qt::AlignLeft,
+            locale.toString(date, "dddd, d MMMM yyyy"));
+
+        // Строки событий; число строк берём из подсчёта, чтобы смещения совпадали
+        p.setFont(font());
+        const QVector<Event>& events = eventsForDay(date);
+        const int rows = qMin(m_dayCounts[day], events.size());
+        for (int row = 0; row < rows; ++row) {
+            const int y = top + kHeaderHeight + row * kRowHeight;
+            if (y + kRowHeight <= 0) continue;
+            if (y >= viewport()->height()) break;
+
+            const Event& item = events[row];
+            p.fillRect(QRect(8, y + 4, 5, kRowHeight - 8), item.color());
+            p.setPen(pal.color(QPalette::Text));
+            const QString time = item.start().date() == date
+                ? item.start().time().toString("hh:mm") : QString("...");
+            p.drawText(QRect(20, y, 50, kRowHeight), Qt::AlignVCenter | Qt::AlignLeft, time);
+            p.drawText(QRect(74, y, width - 82, kRowHeight), Qt::AlignVCenter | Qt::AlignLeft,
+                metrics.elidedText(item.title(), Qt::ElideRight, width - 82));
+        }
+    }
+}
+
+void AgendaView::mousePressEvent(QMouseEvent* event)
+{
+    ensureCounts();
+    const int day = dayAt(verticalScrollBar()->value() + int(event->position().y()));
+    if (m_dayCounts.value(day) > 0) {
+        emit dateClicked(m_rangeStart.addDays(day));
+    }
+    QAbstractScrollArea::mousePressEvent(event);
+}
@@ -0,0 +1,57 @@
+#ifndef AGENDAVIEW_H
+#define AGENDAVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QDate>
+#include <QHash>
+#include <QVector>
+#include "event.h"
+
+class EventStore;
+
+// Лента событий по дням на год вокруг опорной даты. Для прокрутки хранится
+// только число событий в каждом дне (смещения блоков); сами события
+// запрашиваются лишь для дней, попавших в окно.
+class AgendaView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit AgendaView(QWidget* parent = nullptr);
+
+    void setEventStore(const EventStore* store);
+    // true, если источник сменился; сбросить кэш вида - забота вызывающего
+    bool setEventSource(Event::Source source);
+    void setAnchorDate(const QDate& date);
+    void scrollToDate(const QDate& date);
+
+    void invalidate();
+    void invalidateDays(const QDate& from, const QDate& to);
+
+signals:
+    void dateClicked(const QDate& date);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    const EventStore* m_store;
+    Event::Source m_source;
+    QDate m_rangeStart;
+
+    // m_dayOffsets[i] - верх блока дня i, последний элемент - общая высота
+    QVector<int> m_dayCounts;
+    QVector<int> m_dayOffsets;
+    mutable QHash<QDate, QVector<Event>> m_dayEvents;
+    bool m_dirty;
+
+    void ensureCounts();
+    const QVector<Event>& eventsForDay(const QDate& date) const;
+    int dayAt(int y) const;
+    void updateScrollBars();
+};
+
+#endif // AGENDAVIEW_H
@@ -0,0 +1,73 @@
+// Замер памяти на одно событие: N событий с UUID-id проходят путь загрузки
+// (Event::fromJson, затем EventStore::addAll), печатается прирост кучи на
+// событие - отдельно для вектора событий и для хранилища с индексами.
+// Запуск: eventmemory.exe [N], по умолчанию 100000.
+#include <QCoreApplication>
+#include <QJsonObject>
+#include <QUuid>
+#include <cstdio>
+#include <cstdlib>
+#include "../event.h"
+#include "../eventstore.h"
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+    // Занятая процессом память кучи в байтах
+    qint64 heapInUse()
+    {
+#if defined(Q_OS_WIN)
+        PROCESS_MEMORY_COUNTERS_EX counters = {};
+        GetProcessMemoryInfo(GetCurrentProcess(),
+            reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters));
+        return qint64(counters.PrivateUsage);
+#elif defined(__GLIBC__)
+        return qint64(mallinfo2().uordblks);
+#else
+        return 0;
+#endif
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int count = argc > 1 ? qMax(1, std::atoi(argv[1])) : 100000;
+
+    const char* titles[] = { "Standup", "Lunch", "Review", "Planning", "1:1", "Gym" };
+    const char* colors[] = { "#0000ff", "#ff0000", "#008000", "#ffa500" };
+    const QDateTime base = QDateTime::currentDateTime();
+
+    // Без пула строк: так же собирается и версия до компактного Event,
+    // и названия стоят одинаково в обоих замерах
+    const qint64 before = heapInUse();
+    QVector<Event> events;
+    events.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        QJsonObject json;
+        json["id"] = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        json["title"] = titles[i % 6];
+        json["description"] = "";
+        json["start"] = base.addSecs(qint64(i) * 1800).toString(Qt::ISODate);
+        json["end"] = base.addSecs(qint64(i) * 1800 + 3600).toString(Qt::ISODate);
+        json["color"] = colors[i % 4];
+        events.append(Event::fromJson(json));
+    }
+    const qint64 loaded = heapInUse();
+
+    EventStore store;
+    store.addAll(events);
+    events.clear();
+    events.squeeze();
+    const qint64 stored = heapInUse();
+
+    std::printf("events: %d, sizeof(Event): %d B\n", count, int(sizeof(Event)));
+    std::printf("QVector<Event>: %.1f B/event\n", double(loaded - before) / count);
+    std::printf("EventStore:     %.1f B/event\n", double(stored - before) / count);
+    return 0;
+}
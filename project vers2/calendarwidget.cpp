@@ -33,26 +33,20 @@ void CalendarWidget::setupUi()
     connect(m_calendar, &QCalendarWidget::clicked, this, &CalendarWidget::onDateSelected);
     connect(m_addButton, &QPushButton::clicked, this, &CalendarWidget::onAddEvent);
     connect(m_eventsList, &QListWidget::itemDoubleClicked, this, &CalendarWidget::onEventDoubleClicked);
+    connect(&m_store, &EventStore::eventsAdded, this, &CalendarWidget::onStoreChanged);
+    connect(&m_store, &EventStore::eventsChanged, this, &CalendarWidget::onStoreChanged);
+    connect(&m_store, &EventStore::eventsRemoved, this, &CalendarWidget::onStoreChanged);
     onDateSelected(QDate::currentDate());
 }
 
 void CalendarWidget::addEvent(const Event& event)
 {
-    m_events.append(event);
-    updateEventsList();
+    m_store.add(event); // Список обновится по сигналу хранилища
 }
 
 QVector<Event> CalendarWidget::eventsForDate(const QDate& date) const
 {
-    QVector<Event> result;
-    for (const Event& event : m_events) {
-        qDebug() << "Проверка события:" << event.title()
-            << "на" << event.start().date() << date;
-        if (event.start().date() == date) {
-            result.append(event);
-        }
-    }
-    return result;
+    return m_store.eventsForDate(date);
 }
 
 void CalendarWidget::onDateSelected(const QDate& date)
@@ -69,9 +63,18 @@ void CalendarWidget::onAddEvent()
     if (dialog.exec() == QDialog::Accepted) {
         Event newEvent = dialog.getEvent();
         qDebug() << "Добавление события:" << newEvent.title() << "на" << newEvent.start().toString();
-        m_events.append(newEvent);
+        m_store.add(newEvent);
+        qDebug() << "Всего событий теперь:" << m_store.size();
+    }
+}
+
+// Список перестраивается, только если изменение задело выбранный день
+void CalendarWidget::onStoreChanged(const QStringList& ids, const QDate& from, const QDate& to)
+{
+    Q_UNUSED(ids);
+    QDate selected = m_calendar->selectedDate();
+    if ((!from.isValid() || selected >= from) && (!to.isValid() || selected <= to)) {
         updateEventsList();
-        qDebug() << "Всего событий теперь:" << m_events.size();
     }
 }
 
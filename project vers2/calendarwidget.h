@@ -5,6 +5,7 @@
 #include <QDate>
 #include <QVector>
 #include "event.h"
+#include "eventstore.h"
 
 class QCalendarWidget;
 class QListWidget;
@@ -28,12 +29,13 @@ private slots:
     void onDateSelected(const QDate& date);
     void onAddEvent();
     void onEventDoubleClicked(QListWidgetItem* item);  
+    void onStoreChanged(const QStringList& ids, const QDate& from, const QDate& to);
 
 private:
     QCalendarWidget* m_calendar;
     QListWidget* m_eventsList;
     QPushButton* m_addButton;
-    QVector<Event> m_events;
+    EventStore m_store;
     void setupUi();
     void updateEventsList();
 };
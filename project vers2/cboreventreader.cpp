@@ -0,0 +1,219 @@
+#include "cboreventreader.h"
+#include <QCborStreamReader>
+#include <QCborValue>
+#include <QCborMap>
+#include <QJsonObject>
+
+namespace {
+    const int kDiscardThreshold = 64 * 1024;
+
+    enum MajorType {
+        ArrayType = 4,
+        MapType = 5
+    };
+
+    // Заголовок элемента в pos: основной тип и длина (-1 - неопределённая).
+    // Возвращает размер заголовка, 0 - данных пока мало, -1 - заголовок неверен.
+    int readHeader(const QByteArray& buffer, int pos, int& major, qint64& length)
+    {
+        if (pos >= buffer.size()) return 0;
+
+        const uchar initial = uchar(buffer.at(pos));
+        major = initial >> 5;
+        const int info = initial & 0x1F;
+        if (info == 31) {
+            length = -1;
+            return 1;
+        }
+        if (info < 24) {
+            length = info;
+            return 1;
+        }
+        if (info > 27) return -1;
+
+        const int extra = 1 << (info - 24);
+        if (pos + extra >= buffer.size()) return 0;
+        quint64 value = 0;
+        for (int i = 1; i <= extra; ++i) {
+            value = (value << 8) | uchar(buffer.at(pos + i));
+        }
+        length = qint64(value);
+        return 1 + extra;
+    }
+}
+
+CborEventReader::CborEventReader()
+    : m_pos(0)
+    , m_state(Start)
+    , m_remaining(-1)
+    , m_eventsRead(0)
+    , m_tombstones(false)
+{
+}
+
+void CborEventReader::addData(const QByteArray& data)
+{
+    m_buffer.append(data);
+}
+
+//-==========================-
+// Следующее событие из накопленных данных
+//-==========================-
+CborEventReader::Status CborEventReader::readNext(Event& event)
+{
+    for (;;) {
+        switch (m_state) {
+        case Start: {
+            int major = 0;
+            qint64 length = 0;
+            const int header = readHeader(m_buffer, m_pos, major, length);
+            if (header == 0) {
+                return NeedMoreData;
+            }
+            if (header < 0 || (major != ArrayType && major != MapType)) {
+                return fail("Expected CBOR array or map");
+            }
+            m_state = (major == ArrayType) ? InArray : InWrapper;
+            m_remaining = length;
+            m_pos += header;
+            break;
+        }
+
+        case InWrapper: {
+            // Ищем ключ "events" верхнего уровня, остальные пары пропускаем
+            if (m_remaining == 0 || (m_remaining < 0 && atBreak())) {
+                m_state = Done;
+                break;
+            }
+
+            QCborStreamReader reader(m_buffer.constData() + m_pos, m_buffer.size() - m_pos);
+            const QCborValue key = QCborValue::fromCbor(reader);
+            if (reader.lastError() == QCborError::EndOfFile) {
+                discardConsumed();
+                return NeedMoreData;
+            }
+            if (reader.lastError() != QCborError::NoError) {
+                return fail(reader.lastError().toString());
+            }
+
+            if (key.toString() == QLatin1String("events")) {
+                const int valuePos = m_pos + int(reader.currentOffset());
+                int major = 0;
+                qint64 length = 0;
+                const int header = readHeader(m_buffer, valuePos, major, length);
+                if (header == 0) {
+                    discardConsumed();
+                    return NeedMoreData;
+                }
+                if (header > 0 && major == ArrayType) {
+                    m_state = InArray;
+                    m_remaining = length;
+                    m_pos = valuePos + header;
+                    break;
+                }
+            }
+
+            const QCborValue value = QCborValue::fromCbor(reader);
+            Q_UNUSED(value);
+            if (reader.lastError() == QCborError::EndOfFile) {
+                discardConsumed();
+                return NeedMoreData;
+            }
+            if (reader.lastError() != QCborError::NoError) {
+                return fail(reader.lastError().toString());
+            }
+            m_pos += int(reader.currentOffset());
+            if (m_remaining > 0) --m_remaining;
+            break;
+        }
+
+        case InArray: {
+            if (m_remaining == 0) {
+                m_state = Done;
+                break;
+            }
+            if (m_remaining < 0 && atBreak()) {
+                ++m_pos;
+                m_state = Done;
+                break;
+            }
+
+            // Элемент разбирается целиком; если он пришёл не весь - повторим с того же места
+            QCborStreamReader reader(m_buffer.constData() + m_pos, m_buffer.size() - m_pos);
+            const QCborValue value = QCborValue::fromCbor(reader);
+            if (reader.lastError() == QCborError::EndOfFile) {
+                discardConsumed();
+                return NeedMoreData;
+            }
+            if (reader.lastError() != QCborError::NoError) {
+                return fail(reader.lastError().toString());
+            }
+            m_pos += int(reader.currentOffset());
+            if (m_remaining > 0) --m_remaining;
+            if (m_pos >= kDiscardThreshold) {
+                discardConsumed();
+            }
+
+            // Не-объекты пропускаются, как и в JSON
+            if (!value.isMap()) {
+                break;
+            }
+            const QJsonObject object = value.toMap().toJsonObject();
+            if (object.value("deleted").toBool()) {
+                if (!m_tombstones) {
+                    break;
+                }
+                // От удалённого события нужен только id
+                event = Event();
+                event.setId(object.value("id").toString());
+                return Tombstone;
+            }
+            event = Event::fromJson(object, &m_pool);
+            ++m_eventsRead;
+            return EventReady;
+        }
+
+        case Done:
+            return Finished;
+
+        case Failed:
+            return Error;
+        }
+    }
+}
+
+//-==========================-
+// Конец входных данных
+//-==========================-
+CborEventReader::Status CborEventReader::finish()
+{
+    if (m_state == Done) return Finished;
+    if (m_state == Failed) return Error;
+
+    // Пустой ответ - просто нет событий
+    if (m_state == Start && m_pos >= m_buffer.size()) {
+        m_state = Done;
+        return Finished;
+    }
+    return fail("Unexpected end of CBOR data");
+}
+
+// Байт 0xFF закрывает контейнер неопределённой длины
+bool CborEventReader::atBreak() const
+{
+    return m_pos < m_buffer.size() && uchar(m_buffer.at(m_pos)) == 0xFF;
+}
+
+void CborEventReader::discardConsumed()
+{
+    if (m_pos <= 0) return;
+    m_buffer.remove(0, m_pos);
+    m_pos = 0;
+}
+
+CborEventReader::Status CborEventReader::fail(const QString& message)
+{
+    m_state = Failed;
+    m_errorString = message;
+    return Error;
+}
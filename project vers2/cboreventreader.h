@@ -0,0 +1,57 @@
+#ifndef CBOREVENTREADER_H
+#define CBOREVENTREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include "event.h"
+#include "internpool.h"
+
+// Потоковое чтение событий в CBOR (application/cbor) - тот же формат, что и у
+// JsonEventReader: массив событий или map с ключом "events", надгробия
+// { "id": ..., "deleted": true }. Данные добавляются кусками через addData();
+// элемент, пришедший не целиком, разбирается заново после следующего куска.
+class CborEventReader
+{
+public:
+    enum Status {
+        EventReady,
+        Tombstone,
+        NeedMoreData,
+        Finished,
+        Error
+    };
+
+    CborEventReader();
+
+    void addData(const QByteArray& data);
+    void setTombstonesEnabled(bool enabled) { m_tombstones = enabled; }
+    Status readNext(Event& event);
+    // Данных больше не будет (после NeedMoreData): Finished или Error для обрыва
+    Status finish();
+    QString errorString() const { return m_errorString; }
+    qint64 eventsRead() const { return m_eventsRead; }
+
+private:
+    enum State {
+        Start,
+        InWrapper,
+        InArray,
+        Done,
+        Failed
+    };
+
+    QByteArray m_buffer;
+    int m_pos;
+    State m_state;
+    qint64 m_remaining; // Осталось элементов контейнера, -1 - длина не задана
+    qint64 m_eventsRead;
+    bool m_tombstones;
+    QString m_errorString;
+    InternPool m_pool;
+
+    bool atBreak() const;
+    Status fail(const QString& message);
+    void discardConsumed();
+};
+
+#endif // CBOREVENTREADER_H
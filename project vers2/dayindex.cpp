@@ -0,0 +1,108 @@
+#include "dayindex.h"
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace {
+    const int kRebuildChunk = 4096; // Событий на одну задачу при параллельной сборке
+}
+
+qint64 DayIndex::dayKey(const QDateTime& dateTime)
+{
+    return dateTime.isValid() ? dateTime.date().toJulianDay() : InvalidDay;
+}
+
+qint64 DayIndex::dayKey(const Event& event)
+{
+    return event.isRecurring() ? InvalidDay : dayKey(event.start());
+}
+
+void DayIndex::append(qint64 day)
+{
+    int slot = m_slotDay.size();
+    m_slotDay.append(day);
+    m_buckets[day].append(slot);
+}
+
+void DayIndex::update(int slot, qint64 day)
+{
+    if (m_slotDay[slot] == day) return;
+    removeFromBucket(slot);
+    m_slotDay[slot] = day;
+    m_buckets[day].append(slot);
+}
+
+//-==========================-
+// Зеркало удаления в EventStore: последний слот переезжает на место удалённого
+//-==========================-
+void DayIndex::removeSlot(int slot)
+{
+    removeFromBucket(slot);
+
+    int last = m_slotDay.size() - 1;
+    if (slot != last) {
+        qint64 movedDay = m_slotDay[last];
+        QVector<int>& bucket = m_buckets[movedDay];
+        int pos = bucket.indexOf(last);
+        if (pos >= 0) {
+            bucket[pos] = slot;
+        }
+        m_slotDay[slot] = movedDay;
+    }
+    m_slotDay.removeLast();
+}
+
+//-==========================-
+// Полная сборка после загрузки: дни считаются параллельно
+//-==========================-
+void DayIndex::rebuild(const QVector<Event>& events)
+{
+    const int count = events.size();
+    m_buckets.clear();
+    m_slotDay.resize(count);
+
+    // Перевод в локальную дату - самая дорогая часть, её делим по потокам
+    qint64* days = m_slotDay.data();
+    if (count >= 2 * kRebuildChunk) {
+        QVector<int> chunks;
+        for (int begin = 0; begin < count; begin += kRebuildChunk) {
+            chunks.append(begin);
+        }
+        QtConcurrent::blockingMap(chunks, [&events, days, count](int begin) {
+            const int end = qMin(begin + kRebuildChunk, count);
+            for (int i = begin; i < end; ++i) {
+                days[i] = dayKey(events[i]);
+            }
+            });
+    }
+    else {
+        for (int i = 0; i < count; ++i) {
+            days[i] = dayKey(events[i]);
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        m_buckets[days[i]].append(i);
+    }
+}
+
+void DayIndex::clear()
+{
+    m_buckets.clear();
+    m_slotDay.clear();
+}
+
+const QVector<int>* DayIndex::slotsForDay(qint64 day) const
+{
+    auto it = m_buckets.constFind(day);
+    return it != m_buckets.constEnd() ? &it.value() : nullptr;
+}
+
+void DayIndex::removeFromBucket(int slot)
+{
+    auto it = m_buckets.find(m_slotDay[slot]);
+    if (it == m_buckets.end()) return;
+
+    it.value().removeOne(slot);
+    if (it.value().isEmpty()) {
+        m_buckets.erase(it);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef DAYINDEX_H
+#define DAYINDEX_H
+
+#include <QVector>
+#include <QHash>
+#include "event.h"
+
+// Корзины слотов по юлианскому дню начала события.
+// Слоты повторяют расположение событий в EventStore.
+// Повторяющиеся события в корзины не попадают - их вхождения разворачиваются отдельно.
+class DayIndex
+{
+public:
+    static constexpr qint64 InvalidDay = -1;
+
+    static qint64 dayKey(const QDateTime& dateTime);
+    static qint64 dayKey(const Event& event);
+
+    void append(qint64 day);
+    void update(int slot, qint64 day);
+    void removeSlot(int slot);
+    void rebuild(const QVector<Event>& events);
+    void clear();
+
+    const QVector<int>* slotsForDay(qint64 day) const;
+
+private:
+    QHash<qint64, QVector<int>> m_buckets;
+    QVector<qint64> m_slotDay;
+
+    void removeFromBucket(int slot);
+};
+
+#endif // DAYINDEX_H
@@ -1,61 +1,202 @@
 #include "event.h"
+#include "internpool.h"
 #include <QJsonObject>
 #include <QJsonValue>
 #include <QUuid>
+#include <QTimeZone>
 
 Event::Event(const QString& title, const QString& description,
     const QDateTime& start, const QDateTime& end, const QColor& color,
     const QString& id, Source source)
-    : m_title(title), m_description(description), m_start(start),
-    m_end(end), m_color(color), m_source(source)
+    : m_title(title), m_description(description), m_startMs(0), m_endMs(0),
+    m_rgba(0), m_source(source), m_startValid(false), m_endValid(false), m_colorValid(false),
+    m_startZoned(false), m_endZoned(false), m_startZone(0), m_endZone(0)
 {
+    setStart(start);
+    setEnd(end);
+    setColor(color);
     if (id.isEmpty()) {
-        m_id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        m_uuid = QUuid::createUuid();
     }
     else {
-        m_id = id;
+        setId(id);
     }
 }
 
+//-==========================-
+// Сборка из сырых полей без QDateTime/QColor и без генерации UUID
+//-==========================-
+Event Event::fromRaw(const QString& id, const QString& title, const QString& description,
+    const RawTime& start, const RawTime& end, QRgb rgba, bool colorValid, Source source)
+{
+    Event event(title, description, QDateTime(), QDateTime(), QColor(), id, source);
+    event.m_startValid = start.valid;
+    event.m_startMs = start.valid ? start.ms : 0;
+    event.m_startZoned = start.valid && start.zoned;
+    event.m_startZone = start.valid ? start.zone : 0;
+    event.m_endValid = end.valid;
+    event.m_endMs = end.valid ? end.ms : 0;
+    event.m_endZoned = end.valid && end.zoned;
+    event.m_endZone = end.valid ? end.zone : 0;
+    event.m_colorValid = colorValid;
+    event.m_rgba = colorValid ? rgba : 0;
+    return event;
+}
+
 QString Event::title() const { return m_title; }
 QString Event::description() const { return m_description; }
-QDateTime Event::start() const { return m_start; }
-QDateTime Event::end() const { return m_end; }
-QColor Event::color() const { return m_color; }
-QString Event::id() const { return m_id; }
+
+QDateTime Event::start() const
+{
+    return m_startValid ? timeAt(m_startMs, m_startZoned, m_startZone) : QDateTime();
+}
+
+QDateTime Event::end() const
+{
+    return m_endValid ? timeAt(m_endMs, m_endZoned, m_endZone) : QDateTime();
+}
+
+QDateTime Event::timeAt(qint64 ms, bool zoned, qint8 zone)
+{
+    if (!zoned) {
+        return QDateTime::fromMSecsSinceEpoch(ms);
+    }
+    return QDateTime::fromMSecsSinceEpoch(ms, zone == 0
+        ? QTimeZone(QTimeZone::UTC) : QTimeZone::fromSecondsAheadOfUtc(zone * 900));
+}
+
+//-==========================-
+// Смещение времени в четвертях часа; нестандартное смещение (не кратное 15 мин)
+// заменяется на UTC - момент времени при этом не меняется
+//-==========================-
+void Event::zoneOf(const QDateTime& time, quint8& zoned, qint8& zone)
+{
+    zoned = time.isValid() && time.timeSpec() != Qt::LocalTime;
+    zone = 0;
+    if (zoned) {
+        const int offset = time.offsetFromUtc();
+        if (offset % 900 == 0 && qAbs(offset / 900) <= 127) {
+            zone = qint8(offset / 900);
+        }
+    }
+}
+
+QColor Event::color() const
+{
+    return m_colorValid ? QColor::fromRgba(m_rgba) : QColor();
+}
+
+QString Event::id() const
+{
+    return m_uuid.isNull() ? m_rawId : m_uuid.toString(QUuid::WithoutBraces);
+}
 
 void Event::setTitle(const QString& title) { m_title = title; }
 void Event::setDescription(const QString& description) { m_description = description; }
-void Event::setStart(const QDateTime& start) { m_start = start; }
-void Event::setEnd(const QDateTime& end) { m_end = end; }
-void Event::setColor(const QColor& color) { m_color = color; }
-void Event::setId(const QString& id) { m_id = id; }
 
-Event::Source Event::source() const { return m_source; }
+void Event::setStart(const QDateTime& start)
+{
+    m_startValid = start.isValid();
+    m_startMs = m_startValid ? start.toMSecsSinceEpoch() : 0;
+    quint8 zoned = 0;
+    zoneOf(start, zoned, m_startZone);
+    m_startZoned = zoned;
+}
+
+void Event::setEnd(const QDateTime& end)
+{
+    m_endValid = end.isValid();
+    m_endMs = m_endValid ? end.toMSecsSinceEpoch() : 0;
+    quint8 zoned = 0;
+    zoneOf(end, zoned, m_endZone);
+    m_endZoned = zoned;
+}
+
+void Event::setColor(const QColor& color)
+{
+    m_colorValid = color.isValid();
+    m_rgba = m_colorValid ? color.rgba() : 0;
+}
+
+//-==========================-
+// id в двоичном виде, только если он восстанавливается из UUID без изменений
+//-==========================-
+Event::Key Event::keyFor(const QString& id)
+{
+    // Без скобок и в нижнем регистре - так toString(WithoutBraces) вернёт ту же строку
+    if (id.size() == 36) {
+        bool lower = true;
+        for (QChar ch : id) {
+            if (ch >= u'A' && ch <= u'F') {
+                lower = false;
+                break;
+            }
+        }
+        QUuid uuid = lower ? QUuid::fromString(id) : QUuid();
+        if (!uuid.isNull()) {
+            return { uuid, QString() };
+        }
+    }
+    return { QUuid(), id };
+}
+
+void Event::setId(const QString& id)
+{
+    Key key = keyFor(id);
+    m_uuid = key.uuid;
+    m_rawId = key.raw;
+}
+
+Event::Source Event::source() const { return static_cast<Source>(m_source); }
 void Event::setSource(Source source) { m_source = source; }
 
+Recurrence Event::recurrence() const
+{
+    return m_recurrence ? *m_recurrence : Recurrence();
+}
+
+void Event::setRecurrence(const Recurrence& recurrence)
+{
+    if (recurrence.isRecurring()) {
+        m_recurrence = QSharedPointer<const Recurrence>::create(recurrence);
+    }
+    else {
+        m_recurrence.reset();
+    }
+}
+
 QJsonObject Event::toJson() const
 {
     QJsonObject json;
-    json["id"] = m_id;
+    json["id"] = id();
     json["title"] = m_title;
     json["description"] = m_description;
-    json["start"] = m_start.toString(Qt::ISODate);
-    json["end"] = m_end.toString(Qt::ISODate);
-    json["color"] = m_color.name();
-    json["source"] = m_source;
+    json["start"] = start().toString(Qt::ISODate);
+    json["end"] = end().toString(Qt::ISODate);
+    json["color"] = color().name();
+    json["source"] = int(m_source);
+    if (m_recurrence) {
+        json["recurrence"] = m_recurrence->toRule();
+    }
     return json;
 }
 
-Event Event::fromJson(const QJsonObject& json)
+// С пулом одинаковые названия/описания делят буфер, а цвета не разбираются повторно
+Event Event::fromJson(const QJsonObject& json, InternPool* pool)
 {
     Event event;
     event.setId(json["id"].toString());
-    event.setTitle(json["title"].toString());
-    event.setDescription(json["description"].toString());
+    const QString title = json["title"].toString();
+    const QString description = json["description"].toString();
+    event.setTitle(pool ? pool->string(title) : title);
+    event.setDescription(pool ? pool->string(description) : description);
     event.setStart(QDateTime::fromString(json["start"].toString(), Qt::ISODate));
     event.setEnd(QDateTime::fromString(json["end"].toString(), Qt::ISODate));
-    event.setColor(QColor(json["color"].toString()));
+    const QString colorName = json["color"].toString();
+    event.setColor(pool ? pool->color(colorName) : QColor(colorName));
     event.setSource(static_cast<Event::Source>(json["source"].toInt(Event::Local)));
+    if (json.contains("recurrence")) {
+        event.setRecurrence(Recurrence::fromRule(json["recurrence"].toString()));
+    }
     return event;
 }
\ No newline at end of file
@@ -6,7 +6,17 @@
 #include <QDateTime>
 #include <QColor>
 #include <QJsonObject>
+#include <QUuid>
+#include <QHashFunctions>
+#include <QSharedPointer>
+#include "recurrence.h"
 
+class InternPool;
+
+// Компактное хранение: id-UUID в 16 байтах, время - мс UTC, цвет - упакованный RGBA,
+// флаги и источник - битовые поля. QDateTime/QColor/QString собираются в аксессорах.
+// Время, заданное со смещением (Z, +03:00), возвращается с тем же смещением, так что
+// toJson пишет его без потерь; время без смещения остаётся местным.
 class Event
 {
 public:
@@ -15,19 +25,47 @@ public:
         Server  
     };
 
+    // Ключ id для хэшей: UUID в двоичном виде или исходная строка,
+    // получается без сборки строки UUID
+    struct Key {
+        QUuid uuid;
+        QString raw;
+        bool operator==(const Key& other) const { return uuid == other.uuid && raw == other.raw; }
+        bool operator!=(const Key& other) const { return !(*this == other); }
+    };
+
+    // Время в том виде, в каком оно хранится: мс UTC и смещение в четвертях часа
+    // (zoned = false - местное время). Снимок читает и пишет его без QDateTime.
+    struct RawTime {
+        qint64 ms = 0;
+        qint8 zone = 0;
+        bool zoned = false;
+        bool valid = false;
+    };
+
     Event(const QString& title = "", const QString& description = "",
         const QDateTime& start = QDateTime(), const QDateTime& end = QDateTime(),
         const QColor& color = Qt::blue, const QString& id = "",
         Source source = Local);
+    static Event fromRaw(const QString& id, const QString& title, const QString& description,
+        const RawTime& start, const RawTime& end, QRgb rgba, bool colorValid, Source source);
 
     QString title() const;
     QString description() const;
     QDateTime start() const;
     QDateTime end() const;
     QColor color() const;
+    RawTime rawStart() const { return { m_startMs, m_startZone, bool(m_startZoned), bool(m_startValid) }; }
+    RawTime rawEnd() const { return { m_endMs, m_endZone, bool(m_endZoned), bool(m_endValid) }; }
+    bool hasColor() const { return m_colorValid; }
+    QRgb rgba() const { return m_rgba; }
     QString id() const;
+    Key key() const { return { m_uuid, m_rawId }; }
+    static Key keyFor(const QString& id);
     Source source() const;
-    bool isValid() const { return !m_id.isEmpty() && !m_title.isEmpty(); }
+    Recurrence recurrence() const;
+    bool isRecurring() const { return !m_recurrence.isNull(); }
+    bool isValid() const { return (!m_uuid.isNull() || !m_rawId.isEmpty()) && !m_title.isEmpty(); }
     void setTitle(const QString& title);
     void setDescription(const QString& description);
     void setStart(const QDateTime& start);
@@ -35,17 +73,35 @@ public:
     void setColor(const QColor& color);
     void setId(const QString& id);
     void setSource(Source source);
+    void setRecurrence(const Recurrence& recurrence);
     QJsonObject toJson() const;
-    static Event fromJson(const QJsonObject& json);
+    static Event fromJson(const QJsonObject& json, InternPool* pool = nullptr);
 
 private:
     QString m_title;
     QString m_description;
-    QDateTime m_start;
-    QDateTime m_end;
-    QColor m_color;
-    QString m_id;
-    Source m_source;
+    QString m_rawId;    // Только для id, которые не являются UUID
+    QUuid m_uuid;
+    qint64 m_startMs;
+    qint64 m_endMs;
+    QSharedPointer<const Recurrence> m_recurrence; // Пусто у обычных событий
+    QRgb m_rgba;
+    quint8 m_source : 1;
+    quint8 m_startValid : 1;
+    quint8 m_endValid : 1;
+    quint8 m_colorValid : 1;
+    quint8 m_startZoned : 1; // Время задано со смещением от UTC
+    quint8 m_endZoned : 1;
+    qint8 m_startZone;       // Смещение в четвертях часа
+    qint8 m_endZone;
+
+    static QDateTime timeAt(qint64 ms, bool zoned, qint8 zone);
+    static void zoneOf(const QDateTime& time, quint8& zoned, qint8& zone);
 };
 
+inline size_t qHash(const Event::Key& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.uuid, key.raw);
+}
+
 #endif // EVENT_H
\ No newline at end of file
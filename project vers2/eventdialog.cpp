@@ -1,16 +1,25 @@
 #include "eventdialog.h"
 #include "ui_eventdialog.h"
+#include "eventstore.h"
 #include <QColorDialog>
+#include <QMessageBox>
 
 EventDialog::EventDialog(QWidget* parent) :
     QDialog(parent),
     ui(new Ui::EventDialog),
-    m_color(Qt::blue) 
+    m_color(Qt::blue),
+    m_store(nullptr)
 {
     ui->setupUi(this);
     ui->startDateTimeEdit->setDateTime(QDateTime::currentDateTime());
     ui->endDateTimeEdit->setDateTime(QDateTime::currentDateTime().addSecs(3600));
     connect(ui->colorButton, &QPushButton::clicked, this, &EventDialog::onColorButtonClicked);
+
+    //    " " (specialValueText)
+    ui->repeatUntilEdit->setMinimumDate(QDate(2000, 1, 1));
+    ui->repeatUntilEdit->setDate(ui->repeatUntilEdit->minimumDate());
+    connect(ui->repeatCombo, &QComboBox::currentIndexChanged, this, &EventDialog::onRepeatChanged);
+    onRepeatChanged(ui->repeatCombo->currentIndex());
     updateColorButton();
 }
 
@@ -28,6 +37,14 @@ Event EventDialog::getEvent() const
         ui->endDateTimeEdit->dateTime(),          //     /
         m_color);                                 //  
 
+    //       
+    Recurrence recurrence = m_recurrence;
+    recurrence.setFrequency(static_cast<Recurrence::Frequency>(ui->repeatCombo->currentIndex()));
+    recurrence.setCount(ui->repeatCountSpin->value());
+    QDate until = ui->repeatUntilEdit->date();
+    recurrence.setUntil(until > ui->repeatUntilEdit->minimumDate() ? until : QDate());
+    event.setRecurrence(recurrence.isRecurring() ? recurrence : Recurrence());
+
     qDebug() << "    :" << event.start();
     return event;
 }
@@ -40,6 +57,13 @@ void EventDialog::setEvent(const Event& event)
     ui->startDateTimeEdit->setDateTime(event.start());
     ui->endDateTimeEdit->setDateTime(event.end());
     m_color = event.color();
+    m_eventId = event.id();
+
+    m_recurrence = event.recurrence();
+    ui->repeatCombo->setCurrentIndex(m_recurrence.frequency());
+    ui->repeatCountSpin->setValue(m_recurrence.count());
+    ui->repeatUntilEdit->setDate(m_recurrence.until().isValid()
+        ? m_recurrence.until() : ui->repeatUntilEdit->minimumDate());
     updateColorButton();
 }
 
@@ -52,6 +76,13 @@ void EventDialog::onColorButtonClicked()
     }
 }
 
+void EventDialog::onRepeatChanged(int index)
+{
+    bool repeats = index != Recurrence::None;
+    ui->repeatCountSpin->setEnabled(repeats);
+    ui->repeatUntilEdit->setEnabled(repeats);
+}
+
 void EventDialog::updateColorButton()
 {
     QString textColor = m_color.lightness() > 128 ? "black" : "white";
@@ -66,4 +97,35 @@ void EventDialog::setDateTime(const QDateTime& start, const QDateTime& end)
 {
     ui->startDateTimeEdit->setDateTime(start);
     ui->endDateTimeEdit->setDateTime(end);
+}
+
+void EventDialog::setEventStore(const EventStore* store)
+{
+    m_store = store;
+}
+
+void EventDialog::accept()
+{
+    //       (   )
+    if (m_store) {
+        QVector<Event> overlaps = m_store->conflicts(ui->startDateTimeEdit->dateTime(),
+            ui->endDateTimeEdit->dateTime(), m_eventId);
+        if (!overlaps.isEmpty()) {
+            QStringList lines;
+            for (int i = 0; i < overlaps.size() && i < 5; ++i) {
+                lines.append(QString("%1 (%2 - %3)").arg(overlaps[i].title(),
+                    overlaps[i].start().toString("dd.MM hh:mm"),
+                    overlaps[i].end().toString("dd.MM hh:mm")));
+            }
+            if (overlaps.size() > 5) {
+                lines.append(QString("... +%1").arg(overlaps.size() - 5));
+            }
+            if (QMessageBox::question(this, "Time Conflict",
+                "This event overlaps with:\n" + lines.join("\n") + "\n\nSave anyway?")
+                != QMessageBox::Yes) {
+                return;
+            }
+        }
+    }
+    QDialog::accept();
 }
\ No newline at end of file
@@ -9,6 +9,8 @@ namespace Ui {
     class EventDialog;
 }
 
+class EventStore;
+
 class EventDialog : public QDialog
 {
     Q_OBJECT
@@ -19,13 +21,19 @@ public:
     Event getEvent() const;
     void setEvent(const Event& event);
     void setDateTime(const QDateTime& start, const QDateTime& end);
+    void setEventStore(const EventStore* store);
+    void accept() override;
 
 private slots:
     void onColorButtonClicked();
+    void onRepeatChanged(int index);
 
 private:
     Ui::EventDialog* ui;
     QColor m_color;
+    const EventStore* m_store;
+    QString m_eventId;
+    Recurrence m_recurrence;
 
     void updateColorButton();
 };
@@ -0,0 +1,77 @@
+#include "eventitemdelegate.h"
+#include "eventlistmodel.h"
+#include <QApplication>
+#include <QPainter>
+
+namespace {
+    const int kStripWidth = 5;
+    const int kSpacing = 8;
+}
+
+EventItemDelegate::EventItemDelegate(QObject* parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+//-==========================-
+// Рисуем только видимые строки, данные берутся из модели по ролям
+//-==========================-
+void EventItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option,
+    const QModelIndex& index) const
+{
+    QStyleOptionViewItem opt(option);
+    initStyleOption(&opt, index);
+    opt.text.clear();
+    opt.icon = QIcon();
+    opt.features &= ~QStyleOptionViewItem::HasDecoration;
+
+    const QWidget* widget = opt.widget;
+    QStyle* style = widget ? widget->style() : QApplication::style();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+
+    QRect rect = style->subElementRect(QStyle::SE_ItemViewItemText, &opt, widget);
+    const bool selected = opt.state & QStyle::State_Selected;
+    const QColor textColor = opt.palette.color(selected ? QPalette::HighlightedText : QPalette::Text);
+
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+
+    // Цвет события
+    QColor color = index.data(Qt::DecorationRole).value<QColor>();
+    if (color.isValid()) {
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(color);
+        painter->drawRoundedRect(QRect(rect.left(), rect.top() + 2, kStripWidth, rect.height() - 4), 2, 2);
+    }
+    rect.adjust(kStripWidth + kSpacing, 0, 0, 0);
+
+    // Время
+    QFont boldFont = opt.font;
+    boldFont.setBold(true);
+    const QString time = index.data(EventListModel::TimeRole).toString();
+    painter->setFont(boldFont);
+    painter->setPen(textColor);
+    painter->drawText(rect, Qt::AlignVCenter | Qt::AlignLeft, time);
+    rect.adjust(QFontMetrics(boldFont).horizontalAdvance(time) + kSpacing, 0, 0, 0);
+
+    // Метка источника справа
+    const QString tag = index.data(EventListModel::SourceRole).toInt() == Event::Server
+        ? "Серверное" : "Локальное";
+    QFont tagFont = opt.font;
+    tagFont.setPointSizeF(tagFont.pointSizeF() * 0.85);
+    painter->setFont(tagFont);
+    QColor tagColor = textColor;
+    tagColor.setAlphaF(0.6f);
+    painter->setPen(tagColor);
+    painter->drawText(rect, Qt::AlignVCenter | Qt::AlignRight, tag);
+    rect.adjust(0, 0, -(QFontMetrics(tagFont).horizontalAdvance(tag) + kSpacing), 0);
+
+    // Название, обрезанное по ширине
+    painter->setFont(opt.font);
+    painter->setPen(textColor);
+    const QString title = index.data(EventListModel::TitleRole).toString();
+    painter->drawText(rect, Qt::AlignVCenter | Qt::AlignLeft,
+        opt.fontMetrics.elidedText(title, Qt::ElideRight, rect.width()));
+
+    painter->restore();
+}
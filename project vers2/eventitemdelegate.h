@@ -0,0 +1,19 @@
+#ifndef EVENTITEMDELEGATE_H
+#define EVENTITEMDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+// Отрисовка строки события: цветная полоса, время, название и метка источника.
+// Рамка, наведение и выделение остаются за стилем (styleSheet списка).
+class EventItemDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit EventItemDelegate(QObject* parent = nullptr);
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option,
+        const QModelIndex& index) const override;
+};
+
+#endif // EVENTITEMDELEGATE_H
@@ -0,0 +1,254 @@
+#include "eventjournal.h"
+#include "eventsnapshot.h"
+#include "jsoneventreader.h"
+#include "journalwriter.h"
+#include "internpool.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFile>
+#include <QHash>
+#include <QThread>
+#include <QTimer>
+#include <QDebug>
+
+namespace {
+    const int kCompactionThreshold = 1000;          // Записей в журнале до сжатия
+    const int kCompactionIntervalMs = 5 * 60 * 1000; // Периодическое сжатие
+    const int kCompactionDebounceMs = 2000;          // Пауза после пачки изменений
+
+    // Запись журнала применяется как "последний победил" по id,
+    // поэтому повторное воспроизведение поверх свежего снимка безопасно
+    void applyRecord(const QJsonObject& record, QVector<Event>& events,
+        QHash<QString, int>& indexById, InternPool& pool)
+    {
+        const QString op = record["op"].toString();
+        if (op == "remove") {
+            const QString id = record["id"].toString();
+            auto it = indexById.find(id);
+            if (it == indexById.end()) return;
+            int index = it.value();
+            indexById.erase(it);
+            int last = events.size() - 1;
+            if (index != last) {
+                events[index] = events[last];
+                indexById[events[index].id()] = index;
+            }
+            events.removeLast();
+        }
+        else if (op == "add" || op == "update") {
+            Event event = Event::fromJson(record["event"].toObject(), &pool);
+            auto it = indexById.find(event.id());
+            if (it != indexById.end()) {
+                events[it.value()] = event;
+            }
+            else {
+                indexById.insert(event.id(), events.size());
+                events.append(event);
+            }
+        }
+    }
+}
+
+EventJournal::EventJournal(const QString& snapshotPath, const QString& journalPath,
+    QObject* parent)
+    : QObject(parent)
+    , m_snapshotPath(snapshotPath)
+    , m_journalPath(journalPath)
+    , m_recordCount(0)
+    , m_closed(false)
+    , m_snapshotGeneration(0)
+{
+    m_thread = new QThread(this);
+    m_writer = new JournalWriter(snapshotPath, journalPath, &m_snapshotGeneration);
+    m_writer->moveToThread(m_thread);
+    connect(m_thread, &QThread::finished, m_writer, &QObject::deleteLater);
+    connect(m_writer, &JournalWriter::snapshotWritten, this, &EventJournal::onSnapshotWritten);
+    m_thread->start();
+
+    m_compactionDebounce = new QTimer(this);
+    m_compactionDebounce->setSingleShot(true);
+    m_compactionDebounce->setInterval(kCompactionDebounceMs);
+    connect(m_compactionDebounce, &QTimer::timeout, this, &EventJournal::compact);
+
+    m_compactionTimer = new QTimer(this);
+    connect(m_compactionTimer, &QTimer::timeout, this, [this]() {
+        if (m_recordCount > 0) compact();
+        });
+    m_compactionTimer->start(kCompactionIntervalMs);
+}
+
+EventJournal::~EventJournal()
+{
+    close();
+}
+
+void EventJournal::setLegacySnapshotPath(const QString& path)
+{
+    m_legacyPath = path;
+}
+
+void EventJournal::setSnapshotProvider(const std::function<QVector<Event>()>& provider)
+{
+    m_snapshotProvider = provider;
+}
+
+//-==========================-
+// Загрузка: снимок + воспроизведение журнала
+//-==========================-
+QVector<Event> EventJournal::load()
+{
+    QVector<Event> events;
+    if (!EventSnapshot::read(m_snapshotPath, events) && !m_legacyPath.isEmpty()) {
+        // Бинарного снимка ещё нет - переносим события из старого JSON
+        QFile legacy(m_legacyPath);
+        if (legacy.open(QIODevice::ReadOnly)) {
+            JsonEventReader reader(&legacy);
+            Event event;
+            while (reader.readNext(event) == JsonEventReader::EventReady) {
+                events.append(event);
+            }
+            legacy.close();
+            qDebug() << "Imported legacy snapshot" << m_legacyPath;
+            m_compactionDebounce->start();
+        }
+    }
+
+    QHash<QString, int> indexById;
+    indexById.reserve(events.size());
+    for (int i = 0; i < events.size(); ++i) {
+        indexById.insert(events[i].id(), i);
+    }
+
+    m_recordCount = 0;
+
+    QFile journal(m_journalPath);
+    if (journal.open(QIODevice::ReadOnly)) {
+        InternPool pool;
+        qint64 validSize = 0;
+        while (!journal.atEnd()) {
+            QByteArray line = journal.readLine();
+            if (!line.endsWith('\n')) break; // Оборванная запись после сбоя
+
+            QJsonParseError error;
+            QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+            if (error.error != QJsonParseError::NoError || !doc.isObject()) break;
+
+            applyRecord(doc.object(), events, indexById, pool);
+            validSize = journal.pos();
+            ++m_recordCount;
+        }
+        qint64 fileSize = journal.size();
+        journal.close();
+
+        // Отбрасываем повреждённый хвост, чтобы новые записи шли после целых
+        if (validSize < fileSize) {
+            qDebug() << "Journal tail is corrupted, truncating at" << validSize;
+            QFile::resize(m_journalPath, validSize);
+        }
+    }
+
+    qDebug() << "Replayed" << m_recordCount << "journal records";
+    QMetaObject::invokeMethod(m_writer, [writer = m_writer]() {
+        writer->open();
+        }, Qt::QueuedConnection);
+    return events;
+}
+
+void EventJournal::appendAdd(const Event& event)
+{
+    QJsonObject record;
+    record["op"] = "add";
+    record["event"] = event.toJson();
+    appendRecord(record);
+}
+
+void EventJournal::appendUpdate(const Event& event)
+{
+    QJsonObject record;
+    record["op"] = "update";
+    record["event"] = event.toJson();
+    appendRecord(record);
+}
+
+void EventJournal::appendRemove(const QString& eventId)
+{
+    QJsonObject record;
+    record["op"] = "remove";
+    record["id"] = eventId;
+    appendRecord(record);
+}
+
+//-==========================-
+// Запись кодируется здесь, на диск её пишет поток записи
+//-==========================-
+void EventJournal::appendRecord(const QJsonObject& record)
+{
+    if (m_closed) return;
+
+    QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+    line.append('\n');
+    QMetaObject::invokeMethod(m_writer, [writer = m_writer, line]() {
+        writer->appendRecord(line);
+        }, Qt::QueuedConnection);
+    ++m_recordCount;
+
+    // Пачку изменений (например, импорт) сжимаем один раз после паузы
+    if (m_recordCount >= kCompactionThreshold && !m_compactionDebounce->isActive()) {
+        m_compactionDebounce->start();
+    }
+}
+
+//-==========================-
+// Сжатие журнала: неизменяемая копия событий уходит в поток записи
+//-==========================-
+void EventJournal::compact()
+{
+    if (m_closed || !m_snapshotProvider) return;
+
+    m_compactionDebounce->stop();
+    QVector<Event> events = m_snapshotProvider();
+    int generation = m_snapshotGeneration.fetchAndAddOrdered(1) + 1;
+    int records = m_recordCount;
+    QMetaObject::invokeMethod(m_writer, [writer = m_writer, events, generation, records]() {
+        writer->writeSnapshot(events, generation, records);
+        }, Qt::QueuedConnection);
+}
+
+void EventJournal::onSnapshotWritten(bool success, int records)
+{
+    if (success) {
+        m_recordCount = qMax(0, m_recordCount - records);
+    }
+    emit compactionFinished(success);
+}
+
+//-==========================-
+// Дождаться записи всего, что уже поставлено в очередь
+//-==========================-
+void EventJournal::flush()
+{
+    if (m_closed) return;
+    QMetaObject::invokeMethod(m_writer, [writer = m_writer]() {
+        writer->flush();
+        }, Qt::BlockingQueuedConnection);
+}
+
+//-==========================-
+// Завершение работы: итоговый снимок и остановка потока записи
+//-==========================-
+void EventJournal::close()
+{
+    if (m_closed) return;
+
+    if (m_recordCount > 0) {
+        compact();
+    }
+    QMetaObject::invokeMethod(m_writer, [writer = m_writer]() {
+        writer->close();
+        }, Qt::BlockingQueuedConnection);
+
+    m_closed = true;
+    m_thread->quit();
+    m_thread->wait();
+    m_snapshotProvider = nullptr;
+}
@@ -0,0 +1,58 @@
+#ifndef EVENTJOURNAL_H
+#define EVENTJOURNAL_H
+
+#include <QObject>
+#include <QVector>
+#include <QAtomicInt>
+#include <functional>
+#include "event.h"
+
+class QThread;
+class QTimer;
+class JournalWriter;
+
+class EventJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EventJournal(const QString& snapshotPath, const QString& journalPath,
+        QObject* parent = nullptr);
+    ~EventJournal();
+
+    QVector<Event> load();
+    void setLegacySnapshotPath(const QString& path);
+    void setSnapshotProvider(const std::function<QVector<Event>()>& provider);
+
+    void appendAdd(const Event& event);
+    void appendUpdate(const Event& event);
+    void appendRemove(const QString& eventId);
+
+    void compact();
+    void flush();
+    void close();
+    int pendingRecords() const { return m_recordCount; }
+
+signals:
+    void compactionFinished(bool success);
+
+private slots:
+    void onSnapshotWritten(bool success, int records);
+
+private:
+    QString m_snapshotPath;
+    QString m_journalPath;
+    QString m_legacyPath;
+    int m_recordCount;
+    bool m_closed;
+    QAtomicInt m_snapshotGeneration;
+    QThread* m_thread;
+    JournalWriter* m_writer;
+    QTimer* m_compactionTimer;
+    QTimer* m_compactionDebounce;
+    std::function<QVector<Event>()> m_snapshotProvider;
+
+    void appendRecord(const QJsonObject& record);
+};
+
+#endif // EVENTJOURNAL_H
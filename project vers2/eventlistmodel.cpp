@@ -0,0 +1,170 @@
+#include "eventlistmodel.h"
+#include "eventstore.h"
+#include <QSet>
+#include <algorithm>
+
+EventListModel::EventListModel(const EventStore* store, QObject* parent)
+    : QAbstractListModel(parent)
+    , m_store(store)
+{
+}
+
+int EventListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+//-==========================-
+// Данные строки собираются только по запросу представления
+//-==========================-
+QVariant EventListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) return QVariant();
+
+    const Row& row = m_rows[index.row()];
+    switch (role) {
+    case Qt::DisplayRole: {
+        const Event event = eventAt(index.row());
+        return QString("%1 - %2 (%3)")
+            .arg(event.start().time().toString("hh:mm"), event.title(),
+                row.source == Event::Server ? "Серверное" : "Локальное");
+    }
+    case Qt::ToolTipRole:
+        return eventAt(index.row()).description();
+    case Qt::DecorationRole: {
+        const Event* stored = m_store->find(row.key, row.source);
+        return stored ? stored->color() : QVariant();
+    }
+    case EventRole:
+        return QVariant::fromValue(eventAt(index.row()));
+    case SourceRole:
+        return int(row.source);
+    case TimeRole:
+        return QDateTime::fromMSecsSinceEpoch(row.startMs).time().toString("hh:mm");
+    case TitleRole: {
+        const Event* stored = m_store->find(row.key, row.source);
+        return stored ? stored->title() : QString();
+    }
+    default:
+        return QVariant();
+    }
+}
+
+//-==========================-
+// Событие строки; у повторяющегося - конкретное вхождение
+//-==========================-
+Event EventListModel::eventAt(int row) const
+{
+    Event event;
+    eventAt(row, event);
+    return event;
+}
+
+bool EventListModel::eventAt(int row, Event& event) const
+{
+    if (row < 0 || row >= m_rows.size()) return false;
+
+    const Row& key = m_rows[row];
+    const Event* stored = m_store->find(key.key, key.source);
+    if (!stored) return false;
+
+    event = *stored;
+    if (event.isRecurring() && event.start().isValid()) {
+        const qint64 duration = event.end().isValid() ? event.start().msecsTo(event.end()) : 0;
+        event.setStart(QDateTime::fromMSecsSinceEpoch(key.startMs));
+        if (event.end().isValid()) {
+            event.setEnd(event.start().addMSecs(duration));
+        }
+    }
+    return true;
+}
+
+void EventListModel::showDate(const QDate& date, bool includeServer)
+{
+    QVector<Row> rows;
+    for (const Event& event : m_store->eventsForDate(date, Event::Local)) {
+        rows.append({ event.key(), Event::Local, event.start().toMSecsSinceEpoch() });
+    }
+    if (includeServer) {
+        for (const Event& event : m_store->eventsForDate(date, Event::Server)) {
+            rows.append({ event.key(), Event::Server, event.start().toMSecsSinceEpoch() });
+        }
+    }
+    std::sort(rows.begin(), rows.end(), lessThan);
+    setRows(rows);
+}
+
+// Порядок строк: сначала локальные, внутри - по времени начала
+bool EventListModel::lessThan(const Row& a, const Row& b)
+{
+    if (a.source != b.source) return a.source < b.source;
+    if (a.startMs != b.startMs) return a.startMs < b.startMs;
+    if (a.key.uuid != b.key.uuid) return a.key.uuid < b.key.uuid;
+    return a.key.raw < b.key.raw;
+}
+
+//-==========================-
+// Слияние двух отсортированных списков ключей: удаления и вставки пачками
+//-==========================-
+void EventListModel::setRows(const QVector<Row>& rows)
+{
+    int row = 0;
+    int next = 0;
+    while (row < m_rows.size() || next < rows.size()) {
+        if (next == rows.size() || (row < m_rows.size() && lessThan(m_rows[row], rows[next]))) {
+            // Строки, которых больше нет
+            int last = row;
+            while (last + 1 < m_rows.size()
+                && (next == rows.size() || lessThan(m_rows[last + 1], rows[next]))) {
+                ++last;
+            }
+            beginRemoveRows(QModelIndex(), row, last);
+            m_rows.remove(row, last - row + 1);
+            endRemoveRows();
+        }
+        else if (row == m_rows.size() || lessThan(rows[next], m_rows[row])) {
+            // Новые строки
+            int end = next + 1;
+            while (end < rows.size() && (row == m_rows.size() || lessThan(rows[end], m_rows[row]))) {
+                ++end;
+            }
+            beginInsertRows(QModelIndex(), row, row + end - next - 1);
+            for (int i = next; i < end; ++i) {
+                m_rows.insert(row + i - next, rows[i]);
+            }
+            endInsertRows();
+            row += end - next;
+            next = end;
+        }
+        else {
+            ++row;
+            ++next;
+        }
+    }
+}
+
+//-==========================-
+// Перерисовка строк изменённых событий: dataChanged по непрерывным отрезкам
+//-==========================-
+void EventListModel::updateEvents(const QStringList& ids)
+{
+    if (ids.isEmpty() || m_rows.isEmpty()) return;
+
+    QSet<Event::Key> keys;
+    keys.reserve(ids.size());
+    for (const QString& id : ids) {
+        keys.insert(Event::keyFor(id));
+    }
+
+    int first = -1;
+    for (int row = 0; row <= m_rows.size(); ++row) {
+        const bool changed = row < m_rows.size() && keys.contains(m_rows[row].key);
+        if (changed && first < 0) {
+            first = row;
+        }
+        else if (!changed && first >= 0) {
+            emit dataChanged(index(first), index(row - 1));
+            first = -1;
+        }
+    }
+}
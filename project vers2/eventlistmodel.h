@@ -0,0 +1,53 @@
+#ifndef EVENTLISTMODEL_H
+#define EVENTLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include <QDate>
+#include <QStringList>
+#include "event.h"
+
+class EventStore;
+
+// Список событий выбранного дня поверх EventStore. Строка хранит только
+// ключ (id, источник, начало вхождения); текст и цвет берутся из хранилища
+// при отрисовке видимых строк. Обновление сравнивает старые и новые ключи
+// и сообщает представлению только о вставленных и удалённых строках;
+// о правке текста или цвета сообщает updateEvents по id изменённых событий.
+class EventListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        EventRole = Qt::UserRole,
+        SourceRole,
+        TimeRole,
+        TitleRole
+    };
+
+    explicit EventListModel(const EventStore* store, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    void showDate(const QDate& date, bool includeServer);
+    void updateEvents(const QStringList& ids);
+    Event eventAt(int row) const;
+    bool eventAt(int row, Event& event) const;
+
+private:
+    struct Row {
+        Event::Key key;
+        Event::Source source;
+        qint64 startMs;
+    };
+
+    const EventStore* m_store;
+    QVector<Row> m_rows;
+
+    static bool lessThan(const Row& a, const Row& b);
+    void setRows(const QVector<Row>& rows);
+};
+
+#endif // EVENTLISTMODEL_H
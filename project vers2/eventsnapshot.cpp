@@ -0,0 +1,180 @@
+#include "eventsnapshot.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QHash>
+#include <QtEndian>
+#include <QDebug>
+
+namespace {
+    const int kHeaderSize = 32;
+    const int kRecordSize = 40;
+    const quint32 kNoString = 0xFFFFFFFF;
+
+    enum RecordFlags : quint8 {
+        StartValid = 0x01,
+        EndValid = 0x02,
+        ColorValid = 0x04,
+        StartZoned = 0x08, // Время задано со смещением от UTC (с версии 3)
+        EndZoned = 0x10
+    };
+}
+
+//-==========================-
+// Запись снимка (атомарная замена файла)
+//-==========================-
+bool EventSnapshot::write(const QString& path, const QVector<Event>& events)
+{
+    QHash<QString, quint32> stringIndex;
+    QByteArray strings;
+    auto intern = [&](const QString& value) -> quint32 {
+        auto it = stringIndex.constFind(value);
+        if (it != stringIndex.constEnd()) return it.value();
+
+        quint32 index = static_cast<quint32>(stringIndex.size());
+        stringIndex.insert(value, index);
+        QByteArray utf8 = value.toUtf8();
+        char length[4];
+        qToLittleEndian<quint32>(static_cast<quint32>(utf8.size()), length);
+        strings.append(length, 4);
+        strings.append(utf8);
+        return index;
+    };
+
+    QByteArray records(events.size() * kRecordSize, '\0');
+    char* out = records.data();
+    for (const Event& event : events) {
+        // Поля берутся как хранятся - без QDateTime и QColor
+        const Event::RawTime start = event.rawStart();
+        const Event::RawTime end = event.rawEnd();
+
+        quint8 flags = 0;
+        if (start.valid) flags |= StartValid;
+        if (end.valid) flags |= EndValid;
+        if (event.hasColor()) flags |= ColorValid;
+        if (start.zoned) flags |= StartZoned;
+        if (end.zoned) flags |= EndZoned;
+
+        qToLittleEndian<qint64>(start.ms, out);
+        qToLittleEndian<qint64>(end.ms, out + 8);
+        qToLittleEndian<quint32>(intern(event.id()), out + 16);
+        qToLittleEndian<quint32>(intern(event.title()), out + 20);
+        qToLittleEndian<quint32>(intern(event.description()), out + 24);
+        qToLittleEndian<quint32>(event.hasColor() ? (event.rgba() & 0xFFFFFF) : 0, out + 28);
+        out[32] = static_cast<char>(event.source());
+        out[33] = static_cast<char>(flags);
+        out[34] = static_cast<char>(start.zone);
+        out[35] = static_cast<char>(end.zone);
+        qToLittleEndian<quint32>(event.isRecurring()
+            ? intern(event.recurrence().toRule()) : kNoString, out + 36);
+        out += kRecordSize;
+    }
+
+    QByteArray header(kHeaderSize, '\0');
+    char* h = header.data();
+    qToLittleEndian<quint32>(Magic, h);
+    qToLittleEndian<quint16>(Version, h + 4);
+    qToLittleEndian<quint16>(kHeaderSize, h + 6);
+    qToLittleEndian<quint32>(static_cast<quint32>(events.size()), h + 8);
+    qToLittleEndian<quint32>(static_cast<quint32>(stringIndex.size()), h + 12);
+    qToLittleEndian<quint64>(kHeaderSize, h + 16);
+    qToLittleEndian<quint64>(kHeaderSize + strings.size(), h + 24);
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(header);
+    file.write(strings);
+    file.write(records);
+    return file.commit();
+}
+
+//-==========================-
+// Чтение снимка через отображение файла в память
+//-==========================-
+bool EventSnapshot::read(const QString& path, QVector<Event>& events)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    const qint64 size = file.size();
+    if (size < kHeaderSize) return false;
+
+    QByteArray fallback;
+    const uchar* data = file.map(0, size);
+    if (!data) {
+        fallback = file.readAll();
+        data = reinterpret_cast<const uchar*>(fallback.constData());
+    }
+
+    const quint32 magic = qFromLittleEndian<quint32>(data);
+    const quint16 version = qFromLittleEndian<quint16>(data + 4);
+    const quint16 headerSize = qFromLittleEndian<quint16>(data + 6);
+    const quint32 eventCount = qFromLittleEndian<quint32>(data + 8);
+    const quint32 stringCount = qFromLittleEndian<quint32>(data + 12);
+    const quint64 stringsOffset = qFromLittleEndian<quint64>(data + 16);
+    const quint64 recordsOffset = qFromLittleEndian<quint64>(data + 24);
+
+    if (magic != Magic || version > Version || headerSize < kHeaderSize
+        || stringsOffset < headerSize || stringsOffset > recordsOffset
+        || recordsOffset + quint64(eventCount) * kRecordSize > quint64(size)) {
+        qDebug() << "Snapshot header is invalid" << path;
+        return false;
+    }
+
+    // Каждая строка декодируется один раз, события делят её буфер
+    QVector<QString> strings;
+    strings.reserve(stringCount);
+    quint64 pos = stringsOffset;
+    for (quint32 i = 0; i < stringCount; ++i) {
+        if (pos + 4 > recordsOffset) return false;
+        const quint32 length = qFromLittleEndian<quint32>(data + pos);
+        pos += 4;
+        if (pos + length > recordsOffset) return false;
+        strings.append(QString::fromUtf8(reinterpret_cast<const char*>(data + pos), length));
+        pos += length;
+    }
+
+    events.clear();
+    events.reserve(eventCount);
+    const uchar* record = data + recordsOffset;
+    for (quint32 i = 0; i < eventCount; ++i, record += kRecordSize) {
+        const quint32 idIndex = qFromLittleEndian<quint32>(record + 16);
+        const quint32 titleIndex = qFromLittleEndian<quint32>(record + 20);
+        const quint32 descriptionIndex = qFromLittleEndian<quint32>(record + 24);
+        if (idIndex >= stringCount || titleIndex >= stringCount || descriptionIndex >= stringCount) {
+            events.clear();
+            return false;
+        }
+
+        // Мс и цвет переходят в Event как есть, без преобразований часового пояса;
+        // в файлах до версии 3 байты смещений и их флаги нулевые - время местное
+        const quint8 flags = record[33];
+        Event::RawTime start;
+        start.valid = flags & StartValid;
+        start.ms = qFromLittleEndian<qint64>(record);
+        start.zoned = flags & StartZoned;
+        start.zone = static_cast<qint8>(record[34]);
+        Event::RawTime end;
+        end.valid = flags & EndValid;
+        end.ms = qFromLittleEndian<qint64>(record + 8);
+        end.zoned = flags & EndZoned;
+        end.zone = static_cast<qint8>(record[35]);
+        const QRgb rgb = qFromLittleEndian<quint32>(record + 28);
+
+        Event event = Event::fromRaw(strings[idIndex], strings[titleIndex], strings[descriptionIndex],
+            start, end, 0xFF000000 | rgb, flags & ColorValid, static_cast<Event::Source>(record[32]));
+
+        // Правило повторения появилось во второй версии формата
+        if (version >= 2) {
+            const quint32 ruleIndex = qFromLittleEndian<quint32>(record + 36);
+            if (ruleIndex < stringCount) {
+                event.setRecurrence(Recurrence::fromRule(strings[ruleIndex]));
+            }
+        }
+        events.append(event);
+    }
+
+    if (fallback.isEmpty()) {
+        file.unmap(const_cast<uchar*>(data));
+    }
+    return true;
+}
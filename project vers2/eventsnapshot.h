@@ -0,0 +1,26 @@
+#ifndef EVENTSNAPSHOT_H
+#define EVENTSNAPSHOT_H
+
+#include <QString>
+#include <QVector>
+#include "event.h"
+
+// Бинарный снимок локальных событий (little-endian):
+//   заголовок  - 32 байта: magic "EVSN", версия, размер заголовка,
+//                число событий, число строк, смещения таблиц
+//   строки     - (quint32 длина, UTF-8 байты), без повторов
+//   записи     - по 40 байт: начало/конец в мс UTC, индексы строк
+//                id/title/description, упакованный RGB, источник, флаги,
+//                смещения начала/конца в четвертях часа (с версии 3),
+//                индекс строки правила повторения (с версии 2)
+class EventSnapshot
+{
+public:
+    static constexpr quint32 Magic = 0x4E535645; // "EVSN"
+    static constexpr quint16 Version = 3;
+
+    static bool write(const QString& path, const QVector<Event>& events);
+    static bool read(const QString& path, QVector<Event>& events);
+};
+
+#endif // EVENTSNAPSHOT_H
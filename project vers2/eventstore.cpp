@@ -0,0 +1,470 @@
+#include "eventstore.h"
+
+namespace {
+    const int kOccurrenceCacheSize = 32; // Окон развёртки, которые держим в кэше
+
+    // Интервал события в мс; событие без длительности занимает 1 мс
+    void eventInterval(const QDateTime& startTime, const QDateTime& endTime,
+        qint64& start, qint64& end)
+    {
+        if (!startTime.isValid()) {
+            start = end = 0;
+            return;
+        }
+        start = startTime.toMSecsSinceEpoch();
+        end = endTime.isValid() ? endTime.toMSecsSinceEpoch() : start;
+        if (end <= start) {
+            end = start + 1;
+        }
+    }
+}
+
+EventStore::EventStore(QObject* parent)
+    : QObject(parent)
+{
+}
+
+QHash<Event::Key, int>& EventStore::indexFor(Event::Source source)
+{
+    return source == Event::Server ? m_serverIndex : m_localIndex;
+}
+
+const QHash<Event::Key, int>& EventStore::indexFor(Event::Source source) const
+{
+    return source == Event::Server ? m_serverIndex : m_localIndex;
+}
+
+//-==========================-
+// Дни, которые занимает событие; у бессрочной серии to невалиден
+//-==========================-
+void EventStore::affectedDays(const Event& event, QDate& from, QDate& to)
+{
+    from = event.start().date();
+    if (event.isRecurring()) {
+        Recurrence recurrence = event.recurrence();
+        to = recurrence.until().isValid() ? recurrence.until().addDays(1) : QDate();
+        return;
+    }
+    to = event.end() > event.start() ? event.end().addMSecs(-1).date() : from;
+}
+
+void EventStore::ChangeSet::add(const Event& event)
+{
+    ids.append(event.id());
+    extend(event);
+}
+
+void EventStore::ChangeSet::extend(const Event& event)
+{
+    QDate first;
+    QDate last;
+    affectedDays(event, first, last);
+    if (!first.isValid()) {
+        everything = true;
+        return;
+    }
+    from = from.isValid() ? qMin(from, first) : first;
+    if (!last.isValid()) {
+        openEnd = true;
+    }
+    else {
+        to = to.isValid() ? qMax(to, last) : last;
+    }
+}
+
+void EventStore::notify(const ChangeSet& added, const ChangeSet& removed, const ChangeSet& changed)
+{
+    if (!removed.ids.isEmpty()) {
+        emit eventsRemoved(removed.ids, removed.first(), removed.last());
+    }
+    if (!added.ids.isEmpty()) {
+        emit eventsAdded(added.ids, added.first(), added.last());
+    }
+    if (!changed.ids.isEmpty()) {
+        emit eventsChanged(changed.ids, changed.first(), changed.last());
+    }
+}
+
+//-==========================-
+// Добавление (или замена события с тем же id и источником)
+//-==========================-
+void EventStore::add(const Event& event)
+{
+    ChangeSet added;
+    ChangeSet changed;
+
+    QHash<Event::Key, int>& index = indexFor(event.source());
+    auto it = index.constFind(event.key());
+    if (it != index.constEnd()) {
+        int slot = it.value();
+        changed.add(m_events[slot]);
+        changed.extend(event);
+
+        bool wasRecurring = m_events[slot].isRecurring();
+        m_events[slot] = event;
+        m_days.update(slot, DayIndex::dayKey(event));
+        indexInterval(slot, false);
+        trackRecurring(slot, wasRecurring);
+    }
+    else {
+        added.add(event);
+
+        int slot = m_events.size();
+        m_events.append(event);
+        index.insert(event.key(), slot);
+        m_days.append(DayIndex::dayKey(event));
+        indexInterval(slot, true);
+        trackRecurring(slot, false);
+    }
+    notify(added, ChangeSet(), changed);
+}
+
+//-==========================-
+// Массовое добавление (загрузка, скачивание): индекс дней строится целиком
+//-==========================-
+void EventStore::addAll(const QVector<Event>& events)
+{
+    ChangeSet added;
+    ChangeSet changed;
+    insertAll(events, added, changed);
+    notify(added, ChangeSet(), changed);
+}
+
+void EventStore::insertAll(const QVector<Event>& events, ChangeSet& added, ChangeSet& changed)
+{
+    m_events.reserve(m_events.size() + events.size());
+    for (const Event& event : events) {
+        QHash<Event::Key, int>& index = indexFor(event.source());
+        auto it = index.constFind(event.key());
+        int slot = m_events.size();
+        if (it != index.constEnd()) {
+            slot = it.value();
+            changed.add(m_events[slot]);
+            changed.extend(event);
+            m_recurring.remove(slot);
+            m_events[slot] = event;
+            indexInterval(slot, false);
+        }
+        else {
+            added.add(event);
+            index.insert(event.key(), slot);
+            m_events.append(event);
+            indexInterval(slot, true);
+        }
+        if (event.isRecurring()) {
+            m_recurring.insert(slot);
+        }
+    }
+    m_days.rebuild(m_events);
+    m_occurrenceCache.clear();
+}
+
+bool EventStore::update(const Event& event)
+{
+    if (!indexFor(event.source()).contains(event.key())) return false;
+    add(event);
+    return true;
+}
+
+bool EventStore::remove(const QString& id, Event::Source source)
+{
+    auto it = indexFor(source).constFind(Event::keyFor(id));
+    if (it == indexFor(source).constEnd()) return false;
+
+    ChangeSet removed;
+    removed.add(m_events[it.value()]);
+    removeSlot(it.value());
+    notify(ChangeSet(), removed, ChangeSet());
+    return true;
+}
+
+void EventStore::clear(Event::Source source)
+{
+    ChangeSet removed;
+    QVector<Event> kept;
+    for (const Event& event : m_events) {
+        if (event.source() != source) {
+            kept.append(event);
+        }
+        else {
+            removed.add(event);
+        }
+    }
+    if (removed.ids.isEmpty()) return;
+
+    // Оставшиеся события переиндексируются молча - для наблюдателей они не менялись
+    reset();
+    ChangeSet added;
+    ChangeSet changed;
+    insertAll(kept, added, changed);
+    notify(ChangeSet(), removed, ChangeSet());
+}
+
+void EventStore::clear()
+{
+    ChangeSet removed;
+    for (const Event& event : m_events) {
+        removed.add(event);
+    }
+    reset();
+    notify(ChangeSet(), removed, ChangeSet());
+}
+
+void EventStore::reset()
+{
+    m_events.clear();
+    m_localIndex.clear();
+    m_serverIndex.clear();
+    m_days.clear();
+    m_intervals.clear();
+    m_spanning.clear();
+    m_recurring.clear();
+    m_occurrenceCache.clear();
+}
+
+bool EventStore::contains(const QString& id, Event::Source source) const
+{
+    return indexFor(source).contains(Event::keyFor(id));
+}
+
+const Event* EventStore::find(const QString& id, Event::Source source) const
+{
+    return find(Event::keyFor(id), source);
+}
+
+const Event* EventStore::find(const Event::Key& key, Event::Source source) const
+{
+    auto it = indexFor(source).constFind(key);
+    if (it == indexFor(source).constEnd()) return nullptr;
+    return &m_events[it.value()];
+}
+
+int EventStore::count(Event::Source source) const
+{
+    return indexFor(source).size();
+}
+
+QVector<Event> EventStore::events(Event::Source source) const
+{
+    QVector<Event> result;
+    result.reserve(count(source));
+    for (const Event& event : m_events) {
+        if (event.source() == source) {
+            result.append(event);
+        }
+    }
+    return result;
+}
+
+//-==========================-
+// События дня - только из корзины этого дня
+//-==========================-
+QVector<Event> EventStore::eventsForDate(const QDate& date) const
+{
+    QVector<Event> result;
+    for (int slot : slotsForDate(date)) {
+        result.append(m_events[slot]);
+    }
+    result += occurrences(date.startOfDay(), date.addDays(1).startOfDay());
+    return result;
+}
+
+QVector<Event> EventStore::eventsForDate(const QDate& date, Event::Source source) const
+{
+    QVector<Event> result;
+    for (int slot : slotsForDate(date)) {
+        if (m_events[slot].source() == source) {
+            result.append(m_events[slot]);
+        }
+    }
+    result += occurrences(date.startOfDay(), date.addDays(1).startOfDay(), source);
+    return result;
+}
+
+// Корзина дня плюс многодневные события, начавшиеся раньше
+QVector<int> EventStore::slotsForDate(const QDate& date) const
+{
+    QVector<int> result;
+    const qint64 day = date.toJulianDay();
+    const QVector<int>* bucket = m_days.slotsForDay(day);
+    if (bucket) {
+        result = *bucket;
+    }
+
+    const QVector<int> spanning = m_spanning.overlapping(
+        date.startOfDay().toMSecsSinceEpoch(), date.addDays(1).startOfDay().toMSecsSinceEpoch());
+    for (int slot : spanning) {
+        if (DayIndex::dayKey(m_events[slot].start()) != day) {
+            result.append(slot);
+        }
+    }
+    return result;
+}
+
+//-==========================-
+// События, пересекающие [from, to) - неделя, месяц и т.п.
+//-==========================-
+QVector<Event> EventStore::eventsInRange(const QDateTime& from, const QDateTime& to) const
+{
+    QVector<Event> result;
+    for (int slot : m_intervals.overlapping(from.toMSecsSinceEpoch(), to.toMSecsSinceEpoch())) {
+        result.append(m_events[slot]);
+    }
+    result += occurrences(from, to);
+    return result;
+}
+
+QVector<Event> EventStore::eventsInRange(const QDateTime& from, const QDateTime& to,
+    Event::Source source) const
+{
+    QVector<Event> result;
+    for (int slot : m_intervals.overlapping(from.toMSecsSinceEpoch(), to.toMSecsSinceEpoch())) {
+        if (m_events[slot].source() == source) {
+            result.append(m_events[slot]);
+        }
+    }
+    result += occurrences(from, to, source);
+    return result;
+}
+
+//-==========================-
+// Пересечения по времени с другими событиями
+//-==========================-
+QVector<Event> EventStore::conflicts(const QDateTime& start, const QDateTime& end,
+    const QString& excludeId) const
+{
+    qint64 from = 0;
+    qint64 to = 0;
+    eventInterval(start, end, from, to);
+
+    const Event::Key exclude = Event::keyFor(excludeId);
+    QVector<Event> result;
+    for (int slot : m_intervals.overlapping(from, to)) {
+        if (m_events[slot].key() != exclude) {
+            result.append(m_events[slot]);
+        }
+    }
+    const QVector<Event> repeated = occurrences(QDateTime::fromMSecsSinceEpoch(from),
+        QDateTime::fromMSecsSinceEpoch(to));
+    for (const Event& occurrence : repeated) {
+        if (occurrence.key() != exclude) {
+            result.append(occurrence);
+        }
+    }
+    return result;
+}
+
+//-==========================-
+// Вхождения повторяющихся событий в окне [from, to)
+//-==========================-
+QVector<Event> EventStore::occurrences(const QDateTime& from, const QDateTime& to) const
+{
+    if (m_recurring.isEmpty() || !from.isValid() || !to.isValid()) return QVector<Event>();
+
+    const QPair<qint64, qint64> key(from.toMSecsSinceEpoch(), to.toMSecsSinceEpoch());
+    auto cached = m_occurrenceCache.constFind(key);
+    if (cached != m_occurrenceCache.constEnd()) {
+        return cached.value();
+    }
+
+    // Каждое вхождение - копия исходного события со сдвинутым временем и тем же id
+    QVector<Event> result;
+    for (int slot : m_recurring) {
+        const Event& master = m_events[slot];
+        const qint64 duration = master.end().isValid() ? master.start().msecsTo(master.end()) : 0;
+        const QVector<QDateTime> starts = master.recurrence().occurrences(
+            master.start(), duration, from, to);
+        for (const QDateTime& start : starts) {
+            Event occurrence = master;
+            occurrence.setStart(start);
+            if (master.end().isValid()) {
+                occurrence.setEnd(start.addMSecs(duration));
+            }
+            result.append(occurrence);
+        }
+    }
+
+    if (m_occurrenceCache.size() >= kOccurrenceCacheSize) {
+        m_occurrenceCache.clear();
+    }
+    m_occurrenceCache.insert(key, result);
+    return result;
+}
+
+QVector<Event> EventStore::occurrences(const QDateTime& from, const QDateTime& to,
+    Event::Source source) const
+{
+    QVector<Event> result;
+    for (const Event& occurrence : occurrences(from, to)) {
+        if (occurrence.source() == source) {
+            result.append(occurrence);
+        }
+    }
+    return result;
+}
+
+// Учёт повторяющихся слотов; любое их изменение сбрасывает кэш развёртки
+void EventStore::trackRecurring(int slot, bool wasRecurring)
+{
+    bool isRecurring = m_events[slot].isRecurring();
+    if (isRecurring) {
+        m_recurring.insert(slot);
+    }
+    else {
+        m_recurring.remove(slot);
+    }
+    if (wasRecurring || isRecurring) {
+        m_occurrenceCache.clear();
+    }
+}
+
+void EventStore::indexInterval(int slot, bool isNew)
+{
+    qint64 start = 0;
+    qint64 end = 0;
+
+    // Повторяющееся событие ищется через развёртку, в деревья не попадает
+    if (!m_events[slot].isRecurring()) {
+        eventInterval(m_events[slot].start(), m_events[slot].end(), start, end);
+    }
+
+    // В отдельное дерево попадают только события длиннее одного дня
+    bool spansDays = start < end && DayIndex::dayKey(m_events[slot].start())
+        != DayIndex::dayKey(QDateTime::fromMSecsSinceEpoch(end - 1));
+    qint64 spanStart = spansDays ? start : 0;
+    qint64 spanEnd = spansDays ? end : 0;
+
+    if (isNew) {
+        m_intervals.append(start, end);
+        m_spanning.append(spanStart, spanEnd);
+    }
+    else {
+        m_intervals.update(slot, start, end);
+        m_spanning.update(slot, spanStart, spanEnd);
+    }
+}
+
+//-==========================-
+// Удаление слота: последний элемент переезжает на его место
+//-==========================-
+void EventStore::removeSlot(int slot)
+{
+    m_days.removeSlot(slot);
+    m_intervals.removeSlot(slot);
+    m_spanning.removeSlot(slot);
+    indexFor(m_events[slot].source()).remove(m_events[slot].key());
+    if (m_recurring.remove(slot)) {
+        m_occurrenceCache.clear();
+    }
+
+    int last = m_events.size() - 1;
+    if (slot != last) {
+        Event moved = m_events[last];
+        indexFor(moved.source())[moved.key()] = slot;
+        m_events[slot] = moved;
+        if (m_recurring.remove(last)) {
+            m_recurring.insert(slot);
+        }
+    }
+    m_events.removeLast();
+}
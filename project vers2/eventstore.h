@@ -0,0 +1,96 @@
+#ifndef EVENTSTORE_H
+#define EVENTSTORE_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QStringList>
+#include <QSet>
+#include <QPair>
+#include <QDate>
+#include "event.h"
+#include "dayindex.h"
+#include "intervalindex.h"
+
+// Хранилище всех событий: индекс по id (отдельно для каждого источника),
+// корзины по юлианскому дню начала и дерево интервалов [start, end).
+// Повторяющиеся события хранятся одной записью, их вхождения
+// разворачиваются только для запрошенного окна и кэшируются.
+// Удаление - перестановкой с последним элементом.
+// Каждое изменение сообщается сигналом со списком id и диапазоном затронутых
+// дней [from, to]; невалидный to - диапазон открыт справа (бессрочная серия
+// повторов), невалидный from - затронуто всё.
+class EventStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EventStore(QObject* parent = nullptr);
+
+    void add(const Event& event);
+    void addAll(const QVector<Event>& events);
+    bool update(const Event& event);
+    bool remove(const QString& id, Event::Source source);
+    void clear(Event::Source source);
+    void clear();
+
+    bool contains(const QString& id, Event::Source source) const;
+    const Event* find(const QString& id, Event::Source source) const;
+    const Event* find(const Event::Key& key, Event::Source source) const;
+    int count(Event::Source source) const;
+    int size() const { return m_events.size(); }
+
+    const QVector<Event>& all() const { return m_events; }
+    QVector<Event> events(Event::Source source) const;
+    QVector<Event> eventsForDate(const QDate& date) const;
+    QVector<Event> eventsForDate(const QDate& date, Event::Source source) const;
+    QVector<Event> eventsInRange(const QDateTime& from, const QDateTime& to) const;
+    QVector<Event> eventsInRange(const QDateTime& from, const QDateTime& to,
+        Event::Source source) const;
+    QVector<Event> conflicts(const QDateTime& start, const QDateTime& end,
+        const QString& excludeId = QString()) const;
+    static void affectedDays(const Event& event, QDate& from, QDate& to);
+    QVector<Event> occurrences(const QDateTime& from, const QDateTime& to) const;
+    QVector<Event> occurrences(const QDateTime& from, const QDateTime& to,
+        Event::Source source) const;
+
+signals:
+    void eventsAdded(const QStringList& ids, const QDate& from, const QDate& to);
+    void eventsRemoved(const QStringList& ids, const QDate& from, const QDate& to);
+    void eventsChanged(const QStringList& ids, const QDate& from, const QDate& to);
+
+private:
+    // Накопление id и диапазона дней для одного сигнала
+    struct ChangeSet {
+        QStringList ids;
+        QDate from;
+        QDate to;
+        bool openEnd = false;      // Есть бессрочная серия
+        bool everything = false;   // Есть событие без даты
+        void add(const Event& event);
+        void extend(const Event& event);
+        QDate first() const { return everything ? QDate() : from; }
+        QDate last() const { return everything || openEnd ? QDate() : to; }
+    };
+
+    QVector<Event> m_events;
+    QHash<Event::Key, int> m_localIndex;
+    QHash<Event::Key, int> m_serverIndex;
+    DayIndex m_days;
+    IntervalIndex m_intervals;
+    IntervalIndex m_spanning;
+    QSet<int> m_recurring;
+    mutable QHash<QPair<qint64, qint64>, QVector<Event>> m_occurrenceCache;
+
+    QHash<Event::Key, int>& indexFor(Event::Source source);
+    const QHash<Event::Key, int>& indexFor(Event::Source source) const;
+    void removeSlot(int slot);
+    void indexInterval(int slot, bool isNew);
+    QVector<int> slotsForDate(const QDate& date) const;
+    void trackRecurring(int slot, bool wasRecurring);
+    void insertAll(const QVector<Event>& events, ChangeSet& added, ChangeSet& changed);
+    void reset();
+    void notify(const ChangeSet& added, const ChangeSet& removed, const ChangeSet& changed);
+};
+
+#endif // EVENTSTORE_H
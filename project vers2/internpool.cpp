@@ -0,0 +1,43 @@
+#include "internpool.h"
+
+namespace {
+    const int kMaxStrings = 65536; // Предел пула, чтобы уникальные описания не копились вечно
+    const int kMaxInternLength = 256; // Длинные тексты почти всегда уникальны
+}
+
+//-==========================-
+// Возвращает строку из пула (общий неявно разделяемый буфер)
+//-==========================-
+QString InternPool::string(const QString& value)
+{
+    if (value.isEmpty() || value.size() > kMaxInternLength) return value;
+
+    auto it = m_strings.constFind(value);
+    if (it != m_strings.constEnd()) {
+        return *it;
+    }
+
+    if (m_strings.size() >= kMaxStrings) {
+        m_strings.clear();
+    }
+    m_strings.insert(value);
+    return value;
+}
+
+QColor InternPool::color(const QString& name)
+{
+    auto it = m_colors.constFind(name);
+    if (it != m_colors.constEnd()) {
+        return it.value();
+    }
+
+    QColor parsed(name);
+    m_colors.insert(name, parsed);
+    return parsed;
+}
+
+void InternPool::clear()
+{
+    m_strings.clear();
+    m_colors.clear();
+}
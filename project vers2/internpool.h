@@ -0,0 +1,26 @@
+#ifndef INTERNPOOL_H
+#define INTERNPOOL_H
+
+#include <QString>
+#include <QSet>
+#include <QHash>
+#include <QColor>
+
+// Пул повторяющихся значений при массовой загрузке: одинаковые названия
+// ("Standup", "Lunch") делят один буфер QString, а имена цветов
+// разбираются один раз на всю пачку.
+class InternPool
+{
+public:
+    QString string(const QString& value);
+    QColor color(const QString& name);
+    void clear();
+
+    int stringCount() const { return m_strings.size(); }
+
+private:
+    QSet<QString> m_strings;
+    QHash<QString, QColor> m_colors;
+};
+
+#endif // INTERNPOOL_H
@@ -0,0 +1,187 @@
+#include "intervalindex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    const int kMinOverflow = 64; // Хвост, который не стоит сливать с деревом
+}
+
+IntervalIndex::IntervalIndex()
+    : m_stale(0)
+{
+}
+
+//-==========================-
+// Пустой интервал (start >= end) в дерево не попадает
+//-==========================-
+void IntervalIndex::append(qint64 start, qint64 end)
+{
+    m_slotStart.append(start);
+    m_slotEnd.append(end);
+    m_slotState.append(NotIndexed);
+    m_overflowPos.append(-1);
+    track(m_slotStart.size() - 1);
+}
+
+void IntervalIndex::update(int slot, qint64 start, qint64 end)
+{
+    if (m_slotStart[slot] == start && m_slotEnd[slot] == end) return;
+    untrack(slot);
+    m_slotStart[slot] = start;
+    m_slotEnd[slot] = end;
+    track(slot);
+}
+
+// Зеркало удаления в EventStore: последний слот переезжает на место удалённого
+void IntervalIndex::removeSlot(int slot)
+{
+    int last = m_slotStart.size() - 1;
+    untrack(slot);
+    if (slot != last) {
+        // Узел дерева хранит номер слота - после переезда он недействителен
+        untrack(last);
+        m_slotStart[slot] = m_slotStart[last];
+        m_slotEnd[slot] = m_slotEnd[last];
+    }
+    m_slotStart.removeLast();
+    m_slotEnd.removeLast();
+    m_slotState.removeLast();
+    m_overflowPos.removeLast();
+    if (slot != last) {
+        track(slot);
+    }
+}
+
+void IntervalIndex::clear()
+{
+    m_slotStart.clear();
+    m_slotEnd.clear();
+    m_slotState.clear();
+    m_overflowPos.clear();
+    m_nodes.clear();
+    m_maxEnd.clear();
+    m_overflow.clear();
+    m_stale = 0;
+}
+
+// Непустой интервал слота - в хвост (слот ещё не учтён нигде)
+void IntervalIndex::track(int slot)
+{
+    if (m_slotStart[slot] < m_slotEnd[slot]) {
+        m_slotState[slot] = InOverflow;
+        m_overflowPos[slot] = m_overflow.size();
+        m_overflow.append(slot);
+    }
+}
+
+// Слот перестаёт где-либо учитываться: узел дерева устаревает, из хвоста - убираем
+void IntervalIndex::untrack(int slot)
+{
+    if (m_slotState[slot] == InTree) {
+        ++m_stale;
+    }
+    else if (m_slotState[slot] == InOverflow) {
+        // На место слота встаёт последний элемент хвоста
+        const int pos = m_overflowPos[slot];
+        const int moved = m_overflow.last();
+        m_overflow[pos] = moved;
+        m_overflowPos[moved] = pos;
+        m_overflow.removeLast();
+    }
+    m_slotState[slot] = NotIndexed;
+}
+
+//-==========================-
+// Слоты, пересекающие [from, to)
+//-==========================-
+QVector<int> IntervalIndex::overlapping(qint64 from, qint64 to) const
+{
+    const int limit = qMax(kMinOverflow, int(std::sqrt(double(m_nodes.size()))));
+    if (m_overflow.size() + m_stale > limit) {
+        merge();
+    }
+
+    QVector<int> result;
+    if (from < to) {
+        query(0, m_nodes.size(), from, to, result);
+        for (int slot : m_overflow) {
+            if (m_slotStart[slot] < to && m_slotEnd[slot] > from) {
+                result.append(slot);
+            }
+        }
+    }
+    return result;
+}
+
+//-==========================-
+// Слияние: отсортированный хвост и живые узлы дерева - за один проход
+//-==========================-
+void IntervalIndex::merge() const
+{
+    QVector<Node> added;
+    added.reserve(m_overflow.size());
+    for (int slot : m_overflow) {
+        added.append({ m_slotStart[slot], m_slotEnd[slot], slot });
+    }
+    const auto byStart = [](const Node& a, const Node& b) {
+        return a.start < b.start;
+        };
+    std::sort(added.begin(), added.end(), byStart);
+
+    QVector<Node> nodes;
+    nodes.reserve(m_nodes.size() - m_stale + added.size());
+    int next = 0;
+    for (const Node& node : m_nodes) {
+        // Устаревший узел: слот изменён, удалён или переехал
+        if (node.slot >= m_slotState.size() || m_slotState[node.slot] != InTree) continue;
+        while (next < added.size() && byStart(added[next], node)) {
+            nodes.append(added[next++]);
+        }
+        nodes.append(node);
+    }
+    while (next < added.size()) {
+        nodes.append(added[next++]);
+    }
+    // Хвост помечается только теперь - иначе устаревший узел того же слота сошёл бы за живой
+    for (int slot : m_overflow) {
+        m_slotState[slot] = InTree;
+    }
+
+    m_nodes.swap(nodes);
+    m_overflow.clear();
+    m_stale = 0;
+    m_maxEnd.resize(m_nodes.size());
+    buildMaxEnd(0, m_nodes.size());
+}
+
+// Узел поддерева [lo, hi) - его середина; храним максимум конца по поддереву
+qint64 IntervalIndex::buildMaxEnd(int lo, int hi) const
+{
+    if (lo >= hi) return std::numeric_limits<qint64>::min();
+    int mid = lo + (hi - lo) / 2;
+    qint64 maxEnd = qMax(m_nodes[mid].end,
+        qMax(buildMaxEnd(lo, mid), buildMaxEnd(mid + 1, hi)));
+    m_maxEnd[mid] = maxEnd;
+    return maxEnd;
+}
+
+void IntervalIndex::query(int lo, int hi, qint64 from, qint64 to, QVector<int>& out) const
+{
+    if (lo >= hi) return;
+    int mid = lo + (hi - lo) / 2;
+
+    // Всё поддерево заканчивается до начала запроса
+    if (m_maxEnd[mid] <= from) return;
+
+    query(lo, mid, from, to, out);
+
+    // Правее только более поздние начала
+    const Node& node = m_nodes[mid];
+    if (node.start < to) {
+        if (node.end > from && node.slot < m_slotState.size() && m_slotState[node.slot] == InTree) {
+            out.append(node.slot);
+        }
+        query(mid + 1, hi, from, to, out);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef INTERVALINDEX_H
+#define INTERVALINDEX_H
+
+#include <QVector>
+
+// Дерево интервалов [начало, конец) в мс над слотами EventStore.
+// Хранится как отсортированный по началу массив (неявное сбалансированное
+// дерево) с максимумом конца в каждом поддереве. Правки не трогают дерево:
+// изменённый слот помечается устаревшим в дереве и попадает в небольшой
+// несортированный хвост, который просматривается линейно. Когда хвост и
+// устаревшие узлы превышают ~sqrt(n), хвост сортируется и сливается с деревом
+// за O(n). Запрос - O(log n + k + sqrt(n)), правка - O(1), слияние - O(sqrt(n))
+// в пересчёте на правку.
+class IntervalIndex
+{
+public:
+    IntervalIndex();
+
+    void append(qint64 start, qint64 end);
+    void update(int slot, qint64 start, qint64 end);
+    void removeSlot(int slot);
+    void clear();
+
+    QVector<int> overlapping(qint64 from, qint64 to) const;
+
+private:
+    struct Node {
+        qint64 start;
+        qint64 end;
+        int slot;
+    };
+
+    // Где сейчас учтён интервал слота
+    enum SlotState : quint8 {
+        NotIndexed, // Пустой интервал или узел дерева устарел
+        InTree,
+        InOverflow
+    };
+
+    QVector<qint64> m_slotStart;
+    QVector<qint64> m_slotEnd;
+    mutable QVector<quint8> m_slotState;
+    mutable QVector<Node> m_nodes;
+    mutable QVector<qint64> m_maxEnd;
+    mutable QVector<int> m_overflow;
+    QVector<int> m_overflowPos; // Позиция слота в хвосте - удаление за O(1)
+    mutable int m_stale; // Узлы дерева, чьи слоты с тех пор изменились
+
+    void track(int slot);
+    void untrack(int slot);
+    void merge() const;
+    qint64 buildMaxEnd(int lo, int hi) const;
+    void query(int lo, int hi, qint64 from, qint64 to, QVector<int>& out) const;
+};
+
+#endif // INTERVALINDEX_H
@@ -0,0 +1,79 @@
+#include "journalwriter.h"
+#include "eventsnapshot.h"
+#include <QTimer>
+#include <QDebug>
+
+namespace {
+    const int kFlushDelayMs = 250; // Склейка пачки записей в одну операцию записи
+}
+
+JournalWriter::JournalWriter(const QString& snapshotPath, const QString& journalPath,
+    QAtomicInt* snapshotGeneration)
+    : m_snapshotPath(snapshotPath)
+    , m_journalPath(journalPath)
+    , m_snapshotGeneration(snapshotGeneration)
+{
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(kFlushDelayMs);
+    connect(m_flushTimer, &QTimer::timeout, this, &JournalWriter::flush);
+}
+
+void JournalWriter::open()
+{
+    m_journal.setFileName(m_journalPath);
+    if (!m_journal.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qDebug() << "Cannot open journal" << m_journalPath;
+    }
+}
+
+//-==========================-
+// Запись ставится в очередь, на диск уходит пачкой
+//-==========================-
+void JournalWriter::appendRecord(const QByteArray& line)
+{
+    m_pending.append(line);
+    if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void JournalWriter::flush()
+{
+    m_flushTimer->stop();
+    if (m_pending.isEmpty() || !m_journal.isOpen()) return;
+
+    m_journal.write(m_pending);
+    m_journal.flush();
+    m_pending.clear();
+}
+
+//-==========================-
+// Снимок: атомарная замена файла и обнуление журнала
+//-==========================-
+void JournalWriter::writeSnapshot(const QVector<Event>& events, int generation, int records)
+{
+    // Более новый снимок уже в очереди - этот пропускаем
+    if (generation < m_snapshotGeneration->loadAcquire()) return;
+
+    bool success = EventSnapshot::write(m_snapshotPath, events);
+    if (success) {
+        // Все записи, пришедшие раньше запроса, уже попали в снимок.
+        // Если упадём до обнуления - повторное воспроизведение безвредно
+        m_pending.clear();
+        m_flushTimer->stop();
+        if (m_journal.isOpen()) {
+            m_journal.resize(0);
+        }
+    }
+    else {
+        qDebug() << "Snapshot write failed" << m_snapshotPath;
+    }
+    emit snapshotWritten(success, records);
+}
+
+void JournalWriter::close()
+{
+    flush();
+    m_journal.close();
+}
@@ -0,0 +1,39 @@
+#ifndef JOURNALWRITER_H
+#define JOURNALWRITER_H
+
+#include <QObject>
+#include <QFile>
+#include <QAtomicInt>
+#include <QVector>
+#include "event.h"
+
+class QTimer;
+
+// Живёт в отдельном потоке: все операции с диском выполняются здесь
+class JournalWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    JournalWriter(const QString& snapshotPath, const QString& journalPath,
+        QAtomicInt* snapshotGeneration);
+
+    void open();
+    void appendRecord(const QByteArray& line);
+    void writeSnapshot(const QVector<Event>& events, int generation, int records);
+    void flush();
+    void close();
+
+signals:
+    void snapshotWritten(bool success, int records);
+
+private:
+    QString m_snapshotPath;
+    QString m_journalPath;
+    QFile m_journal;
+    QByteArray m_pending;
+    QTimer* m_flushTimer;
+    QAtomicInt* m_snapshotGeneration;
+};
+
+#endif // JOURNALWRITER_H
@@ -0,0 +1,257 @@
+#include "jsoneventreader.h"
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+    const qint64 kChunkSize = 64 * 1024;
+
+    bool isSpace(char c)
+    {
+        // BOM в начале файла пропускаем так же, как пробелы
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t'
+            || c == '\xEF' || c == '\xBB' || c == '\xBF';
+    }
+}
+
+JsonEventReader::JsonEventReader(QIODevice* device)
+    : m_device(device)
+    , m_pos(0)
+    , m_state(Start)
+    , m_depth(0)
+    , m_inString(false)
+    , m_escape(false)
+    , m_elementStart(0)
+    , m_stringStart(0)
+    , m_eventsRead(0)
+    , m_tombstones(false)
+{
+}
+
+void JsonEventReader::addData(const QByteArray& data)
+{
+    m_buffer.append(data);
+}
+
+//-==========================-
+// Следующее событие (с подкачкой из устройства)
+//-==========================-
+JsonEventReader::Status JsonEventReader::readNext(Event& event)
+{
+    for (;;) {
+        Status status = scan(event);
+        if (status != NeedMoreData || !m_device) {
+            return status;
+        }
+
+        QByteArray chunk = m_device->read(kChunkSize);
+        if (chunk.isEmpty()) {
+            return finish();
+        }
+        addData(chunk);
+    }
+}
+
+//-==========================-
+// Конец входных данных
+//-==========================-
+JsonEventReader::Status JsonEventReader::finish()
+{
+    if (m_state == Done) return Finished;
+    if (m_state == Failed) return Error;
+
+    // Пустой ответ - просто нет событий
+    if (m_state == Start) {
+        m_state = Done;
+        return Finished;
+    }
+    return fail("Unexpected end of JSON data");
+}
+
+JsonEventReader::Status JsonEventReader::scan(Event& event)
+{
+    while (m_pos < m_buffer.size()) {
+        const char c = m_buffer.at(m_pos);
+
+        switch (m_state) {
+        case Start:
+            if (isSpace(c)) {
+                ++m_pos;
+            }
+            else if (c == '[') {
+                m_state = InArray;
+                ++m_pos;
+            }
+            else if (c == '{') {
+                m_state = InWrapper;
+                m_depth = 1;
+                ++m_pos;
+            }
+            else {
+                return fail("Expected JSON array or object");
+            }
+            break;
+
+        case InWrapper:
+            // Ищем поле "events" верхнего уровня
+            if (m_inString) {
+                if (m_escape) {
+                    m_escape = false;
+                }
+                else if (c == '\\') {
+                    m_escape = true;
+                }
+                else if (c == '"') {
+                    m_inString = false;
+                    if (m_depth == 1) {
+                        m_lastString = m_buffer.mid(m_stringStart, m_pos - m_stringStart);
+                    }
+                }
+            }
+            else if (c == '"') {
+                m_inString = true;
+                m_stringStart = m_pos + 1;
+            }
+            else if (c == ':' && m_depth == 1) {
+                m_pendingKey = m_lastString;
+            }
+            else if (c == ',' && m_depth == 1) {
+                m_pendingKey.clear();
+            }
+            else if (c == '[' && m_depth == 1 && m_pendingKey == "events") {
+                m_state = InArray;
+            }
+            else if (c == '{' || c == '[') {
+                ++m_depth;
+            }
+            else if (c == '}' || c == ']') {
+                if (--m_depth == 0) {
+                    m_state = Done;
+                }
+            }
+            ++m_pos;
+            break;
+
+        case InArray:
+            if (isSpace(c) || c == ',') {
+                ++m_pos;
+                break;
+            }
+            if (c == ']') {
+                m_state = Done;
+                ++m_pos;
+                break;
+            }
+            if (c == '}') {
+                return fail("Unexpected '}' in events array");
+            }
+            // Символ разбирается повторно уже в состоянии элемента
+            m_elementStart = m_pos;
+            m_depth = 0;
+            m_inString = false;
+            m_escape = false;
+            m_state = (c == '{') ? InElement : SkipValue;
+            break;
+
+        case InElement:
+        case SkipValue:
+            if (m_inString) {
+                if (m_escape) {
+                    m_escape = false;
+                }
+                else if (c == '\\') {
+                    m_escape = true;
+                }
+                else if (c == '"') {
+                    m_inString = false;
+                }
+                ++m_pos;
+                break;
+            }
+            if (c == '"') {
+                m_inString = true;
+            }
+            else if (c == '{' || c == '[') {
+                ++m_depth;
+            }
+            else if (c == '}' || c == ']') {
+                if (m_depth == 0) {
+                    // Конец массива после пропущенного скаляра
+                    m_state = InArray;
+                    break;
+                }
+                if (--m_depth == 0 && m_state == InElement) {
+                    ++m_pos;
+                    QJsonParseError error;
+                    QJsonDocument doc = QJsonDocument::fromJson(
+                        m_buffer.mid(m_elementStart, m_pos - m_elementStart), &error);
+                    m_state = InArray;
+                    if (m_pos >= kChunkSize) {
+                        discardConsumed();
+                    }
+                    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+                        return fail(error.errorString());
+                    }
+                    const QJsonObject object = doc.object();
+                    if (object.value("deleted").toBool()) {
+                        if (!m_tombstones) {
+                            break;
+                        }
+                        // От удалённого события нужен только id
+                        event = Event();
+                        event.setId(object.value("id").toString());
+                        return Tombstone;
+                    }
+                    event = Event::fromJson(object, &m_pool);
+                    ++m_eventsRead;
+                    return EventReady;
+                }
+            }
+            else if (c == ',' && m_depth == 0 && m_state == SkipValue) {
+                m_state = InArray;
+                break;
+            }
+            ++m_pos;
+            break;
+
+        case Done:
+            return Finished;
+
+        case Failed:
+            return Error;
+        }
+    }
+
+    if (m_state == Done) return Finished;
+    if (m_state == Failed) return Error;
+
+    discardConsumed();
+    return NeedMoreData;
+}
+
+//-==========================-
+// Сброс уже разобранной части буфера
+//-==========================-
+void JsonEventReader::discardConsumed()
+{
+    int keep = m_pos;
+    if (m_state == InElement) {
+        keep = m_elementStart;
+    }
+    else if (m_state == InWrapper && m_inString) {
+        keep = m_stringStart;
+    }
+    if (keep <= 0) return;
+
+    m_buffer.remove(0, keep);
+    m_pos -= keep;
+    m_elementStart -= keep;
+    m_stringStart -= keep;
+}
+
+JsonEventReader::Status JsonEventReader::fail(const QString& message)
+{
+    m_state = Failed;
+    m_errorString = message;
+    return Error;
+}
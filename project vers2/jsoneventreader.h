@@ -0,0 +1,68 @@
+#ifndef JSONEVENTREADER_H
+#define JSONEVENTREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include "event.h"
+#include "internpool.h"
+
+class QIODevice;
+
+// Потоковое чтение массива событий: "[ {...}, ... ]" или "{ "events": [ ... ] }".
+// Разбирается только текущий объект, поэтому память не зависит от размера файла.
+// Элементы вида { "id": ..., "deleted": true } - надгробия удалённых на сервере
+// событий; без setTombstonesEnabled(true) они пропускаются.
+class JsonEventReader
+{
+public:
+    enum Status {
+        EventReady,
+        Tombstone,
+        NeedMoreData,
+        Finished,
+        Error
+    };
+
+    explicit JsonEventReader(QIODevice* device = nullptr);
+
+    void addData(const QByteArray& data);
+    void setTombstonesEnabled(bool enabled) { m_tombstones = enabled; }
+    Status readNext(Event& event);
+    // Данных больше не будет (после NeedMoreData): Finished или Error для обрыва
+    Status finish();
+    QString errorString() const { return m_errorString; }
+    qint64 eventsRead() const { return m_eventsRead; }
+
+private:
+    enum State {
+        Start,
+        InWrapper,
+        InArray,
+        InElement,
+        SkipValue,
+        Done,
+        Failed
+    };
+
+    QIODevice* m_device;
+    QByteArray m_buffer;
+    int m_pos;
+    State m_state;
+    int m_depth;
+    bool m_inString;
+    bool m_escape;
+    int m_elementStart;
+    int m_stringStart;
+    QByteArray m_lastString;
+    QByteArray m_pendingKey;
+    qint64 m_eventsRead;
+    bool m_tombstones;
+    QString m_errorString;
+    InternPool m_pool;
+
+    Status scan(Event& event);
+    Status fail(const QString& message);
+    void discardConsumed();
+};
+
+#endif // JSONEVENTREADER_H
@@ -0,0 +1,472 @@
+#include "localsyncserver.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QUuid>
+#include <QFile>
+#include <QSaveFile>
+#include <QTimer>
+#include <QVector>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QCborValue>
+#include <QCborMap>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+    const int kMaxRequestSize = 16 * 1024 * 1024;
+    const int kCompressThreshold = 1024;
+    // Комментарий в поток подписки, чтобы клиент и прокси не сочли его зависшим
+    const int kKeepAliveMs = 15000;
+
+    QByteArray reasonPhrase(int status)
+    {
+        switch (status) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 415: return "Unsupported Media Type";
+        default: return "Error";
+        }
+    }
+
+    // Тело запроса - объект в JSON или CBOR, смотря по Content-Type
+    bool parseObject(const QHash<QByteArray, QByteArray>& headers, const QByteArray& body, QJsonObject& object)
+    {
+        if (headers.value("content-type").startsWith("application/cbor")) {
+            QCborParserError error;
+            const QCborValue value = QCborValue::fromCbor(body, &error);
+            if (error.error != QCborError::NoError || !value.isMap()) {
+                return false;
+            }
+            object = value.toMap().toJsonObject();
+            return true;
+        }
+
+        const QJsonDocument doc = QJsonDocument::fromJson(body);
+        if (!doc.isObject()) {
+            return false;
+        }
+        object = doc.object();
+        return true;
+    }
+}
+
+LocalSyncServer::LocalSyncServer(const QString& dataPath, QObject* parent)
+    : QObject(parent)
+    , m_server(new QTcpServer(this))
+    , m_dataPath(dataPath)
+    , m_revision(0)
+    , m_deflateReply(false)
+    , m_keepAlive(new QTimer(this))
+{
+    connect(m_server, &QTcpServer::newConnection, this, &LocalSyncServer::onNewConnection);
+    connect(m_keepAlive, &QTimer::timeout, this, [this]() { broadcast(": keepalive\n\n"); });
+    m_keepAlive->start(kKeepAliveMs);
+    load();
+}
+
+bool LocalSyncServer::listen(quint16 port)
+{
+    // Только локальный интерфейс - это инструмент проверки, а не настоящий сервер
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qDebug() << "Локальный сервер не запущен:" << m_server->errorString();
+        return false;
+    }
+    qDebug() << "Локальный сервер слушает порт" << m_server->serverPort()
+             << "ревизия" << m_revision;
+    return true;
+}
+
+quint16 LocalSyncServer::port() const
+{
+    return m_server->serverPort();
+}
+
+void LocalSyncServer::onNewConnection()
+{
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, &LocalSyncServer::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_buffers.remove(socket);
+            m_subscribers.removeAll(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+//-==========================-
+// Разбор HTTP/1.1 запросов соединения
+//-==========================-
+void LocalSyncServer::onReadyRead()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) return;
+
+    QByteArray& buffer = m_buffers[socket];
+    buffer.append(socket->readAll());
+
+    // Запросов в буфере может быть несколько (keep-alive)
+    for (;;) {
+        const int headerEnd = buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            if (buffer.size() > kMaxRequestSize) {
+                send(socket, 413);
+                socket->disconnectFromHost();
+            }
+            return;
+        }
+
+        const QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+        const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+        if (requestLine.size() < 2) {
+            send(socket, 400);
+            socket->disconnectFromHost();
+            return;
+        }
+
+        QHash<QByteArray, QByteArray> headers;
+        for (int i = 1; i < lines.size(); ++i) {
+            const int colon = lines[i].indexOf(':');
+            if (colon > 0) {
+                headers.insert(lines[i].left(colon).trimmed().toLower(), lines[i].mid(colon + 1).trimmed());
+            }
+        }
+
+        const qint64 length = headers.value("content-length").toLongLong();
+        if (length < 0 || length > kMaxRequestSize) {
+            send(socket, 413);
+            socket->disconnectFromHost();
+            return;
+        }
+        if (buffer.size() < headerEnd + 4 + length) {
+            return; // Тело ещё не пришло целиком
+        }
+
+        QByteArray body = buffer.mid(headerEnd + 4, length);
+        buffer.remove(0, headerEnd + 4 + length);
+
+        m_deflateReply = headers.value("accept-encoding").contains("deflate");
+
+        // Сжатое тело (deflate = zlib); длина для qUncompress - лишь подсказка
+        const QByteArray encoding = headers.value("content-encoding").toLower();
+        if (encoding == "deflate") {
+            body = qUncompress(QByteArray(4, '\0') + body);
+            if (body.isEmpty() || body.size() > kMaxRequestSize) {
+                send(socket, 400);
+                continue;
+            }
+        }
+        else if (!encoding.isEmpty() && encoding != "identity") {
+            send(socket, 415);
+            continue;
+        }
+
+        handleRequest(socket, requestLine[0], QUrl(QString::fromUtf8(requestLine[1])), headers, body);
+    }
+}
+
+//-==========================-
+// Маршрутизация: .../events, .../events/sync, .../events/<id>
+//-==========================-
+void LocalSyncServer::handleRequest(QTcpSocket* socket, const QByteArray& method, const QUrl& url,
+    const QHash<QByteArray, QByteArray>& headers, const QByteArray& body)
+{
+    // Префикс пути (например /api) не важен
+    const QString path = url.path();
+    const int index = path.lastIndexOf("/events");
+    if (index < 0) {
+        send(socket, 404);
+        return;
+    }
+    const QString rest = path.mid(index + 7);
+    const bool cbor = headers.value("accept").contains("application/cbor");
+
+    if (rest.isEmpty() || rest == "/") {
+        if (method == "GET") {
+            listEvents(socket, url, headers.value("if-none-match"), cbor);
+        }
+        else if (method == "POST") {
+            QJsonObject json;
+            if (!parseObject(headers, body, json)) {
+                send(socket, 400);
+                return;
+            }
+            json["id"] = upsert(json);
+            save();
+            sendObject(socket, 201, json, cbor);
+        }
+        else {
+            send(socket, 405);
+        }
+        return;
+    }
+
+    if (rest == "/stream") {
+        if (method != "GET") {
+            send(socket, 405);
+            return;
+        }
+        subscribe(socket, url, headers.value("last-event-id"));
+        return;
+    }
+
+    if (rest == "/sync") {
+        QJsonObject payload;
+        if (method != "POST" || !parseObject(headers, body, payload)) {
+            send(socket, method != "POST" ? 405 : 400);
+            return;
+        }
+        const QJsonArray events = payload.value("events").toArray();
+        for (const QJsonValue& value : events) {
+            upsert(value.toObject());
+        }
+        save();
+        sendObject(socket, 200, QJsonObject{ { "accepted", int(events.size()) } }, cbor);
+        return;
+    }
+
+    const QString id = QUrl::fromPercentEncoding(rest.mid(1).toUtf8());
+    if (method == "PUT") {
+        QJsonObject json;
+        if (!parseObject(headers, body, json)) {
+            send(socket, 400);
+            return;
+        }
+        json["id"] = id;
+        upsert(json);
+        save();
+        sendObject(socket, 200, json, cbor);
+    }
+    else if (method == "DELETE") {
+        if (!removeEvent(id)) {
+            send(socket, 404);
+            return;
+        }
+        save();
+        sendObject(socket, 200, QJsonObject(), cbor);
+    }
+    else {
+        send(socket, 405);
+    }
+}
+
+//-==========================-
+// Список событий: полный или изменения после курсора
+//-==========================-
+void LocalSyncServer::listEvents(QTcpSocket* socket, const QUrl& url, const QByteArray& ifNoneMatch, bool cbor)
+{
+    const Headers stateHeaders = {
+        { "ETag", etag() },
+        { "X-Sync-Cursor", QByteArray::number(m_revision) }
+    };
+    if (!ifNoneMatch.isEmpty() && ifNoneMatch == etag()) {
+        send(socket, 304, QByteArray(), stateHeaders);
+        return;
+    }
+
+    // Курсор из будущего - от другого экземпляра данных, отдаём всё
+    bool ok = false;
+    const qint64 since = QUrlQuery(url).queryItemValue("since").toLongLong(&ok);
+    const bool full = !ok || since < 0 || since > m_revision;
+
+    QJsonArray events;
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        const Entry& entry = it.value();
+        if (full) {
+            if (!entry.deleted) {
+                events.append(entry.json);
+            }
+        }
+        else if (entry.revision > since) {
+            events.append(entry.deleted
+                ? QJsonObject{ { "id", it.key() }, { "deleted", true } }
+                : entry.json);
+        }
+    }
+
+    Headers headers = stateHeaders;
+    if (full) {
+        headers.append(qMakePair(QByteArray("X-Sync-Full"), QByteArray("1")));
+    }
+    sendObject(socket, 200, QJsonObject{ { "events", events } }, cbor, headers);
+}
+
+//-==========================-
+// Подписка: ответ без конца (chunked), каждое изменение - событие SSE
+//-==========================-
+void LocalSyncServer::subscribe(QTcpSocket* socket, const QUrl& url, const QByteArray& lastEventId)
+{
+    socket->write("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: text/event-stream\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Transfer-Encoding: chunked\r\n"
+                  "\r\n");
+    m_subscribers.append(socket);
+    pushTo(socket, "retry: 2000\n\n");
+
+    // Переподключение присылает Last-Event-ID, первое подключение - since
+    bool ok = false;
+    qint64 since = lastEventId.toLongLong(&ok);
+    if (!ok) {
+        since = QUrlQuery(url).queryItemValue("since").toLongLong(&ok);
+    }
+    if (!ok || since < 0 || since > m_revision) {
+        pushTo(socket, "event: reset\ndata: {}\n\n");
+        return;
+    }
+
+    // Пропущенное после курсора - в порядке ревизий
+    QVector<QPair<qint64, QString>> missed;
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        if (it->revision > since) {
+            missed.append(qMakePair(it->revision, it.key()));
+        }
+    }
+    std::sort(missed.begin(), missed.end());
+    for (const auto& entry : missed) {
+        pushTo(socket, streamMessage(entry.second, m_entries.value(entry.second)));
+    }
+}
+
+QByteArray LocalSyncServer::streamMessage(const QString& id, const Entry& entry) const
+{
+    const QJsonObject data = entry.deleted ? QJsonObject{ { "id", id } } : entry.json;
+    return "id: " + QByteArray::number(entry.revision)
+        + "\nevent: " + (entry.deleted ? "delete" : "upsert")
+        + "\ndata: " + QJsonDocument(data).toJson(QJsonDocument::Compact) + "\n\n";
+}
+
+void LocalSyncServer::pushTo(QTcpSocket* socket, const QByteArray& message)
+{
+    socket->write(QByteArray::number(message.size(), 16) + "\r\n" + message + "\r\n");
+}
+
+void LocalSyncServer::broadcast(const QByteArray& message)
+{
+    for (QTcpSocket* socket : m_subscribers) {
+        pushTo(socket, message);
+    }
+}
+
+QString LocalSyncServer::upsert(QJsonObject json)
+{
+    QString id = json.value("id").toString();
+    if (id.isEmpty()) {
+        id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        json["id"] = id;
+    }
+
+    Entry& entry = m_entries[id];
+    entry.json = json;
+    entry.deleted = false;
+    entry.revision = ++m_revision;
+    broadcast(streamMessage(id, entry));
+    return id;
+}
+
+bool LocalSyncServer::removeEvent(const QString& id)
+{
+    auto it = m_entries.find(id);
+    if (it == m_entries.end() || it->deleted) {
+        return false;
+    }
+    // Запись остаётся надгробием, чтобы клиенты с курсором узнали об удалении
+    it->json = QJsonObject();
+    it->deleted = true;
+    it->revision = ++m_revision;
+    broadcast(streamMessage(id, *it));
+    return true;
+}
+
+QByteArray LocalSyncServer::etag() const
+{
+    return '"' + QByteArray::number(m_revision) + '"';
+}
+
+void LocalSyncServer::sendObject(QTcpSocket* socket, int status, const QJsonObject& object, bool cbor,
+    const Headers& headers)
+{
+    if (cbor) {
+        send(socket, status, QCborValue::fromJsonValue(object).toCbor(), headers, "application/cbor");
+    }
+    else {
+        send(socket, status, QJsonDocument(object).toJson(QJsonDocument::Compact), headers);
+    }
+}
+
+void LocalSyncServer::send(QTcpSocket* socket, int status, const QByteArray& body, const Headers& headers,
+    const QByteArray& contentType)
+{
+    // Большие ответы сжимаются, если клиент это принимает
+    QByteArray payload = body;
+    const bool deflate = m_deflateReply && status != 304 && body.size() >= kCompressThreshold;
+    if (deflate) {
+        payload = qCompress(body).mid(4);
+    }
+
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + ' ' + reasonPhrase(status) + "\r\n";
+    if (status != 304) {
+        response += "Content-Type: " + contentType + "\r\n";
+        response += "Content-Length: " + QByteArray::number(payload.size()) + "\r\n";
+    }
+    if (deflate) {
+        response += "Content-Encoding: deflate\r\n";
+    }
+    for (const auto& header : headers) {
+        response += header.first + ": " + header.second + "\r\n";
+    }
+    response += "\r\n";
+    if (status != 304) {
+        response += payload;
+    }
+    socket->write(response);
+}
+
+//-==========================-
+// Хранение данных между запусками
+//-==========================-
+void LocalSyncServer::load()
+{
+    QFile file(m_dataPath);
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    m_revision = root.value("revision").toInteger();
+    const QJsonArray entries = root.value("entries").toArray();
+    for (const QJsonValue& value : entries) {
+        const QJsonObject object = value.toObject();
+        Entry entry;
+        entry.json = object.value("event").toObject();
+        entry.revision = object.value("revision").toInteger();
+        entry.deleted = object.value("deleted").toBool();
+        m_entries.insert(object.value("id").toString(), entry);
+    }
+}
+
+void LocalSyncServer::save() const
+{
+    QJsonArray entries;
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        entries.append(QJsonObject{
+            { "id", it.key() },
+            { "event", it->json },
+            { "revision", it->revision },
+            { "deleted", it->deleted } });
+    }
+
+    QSaveFile file(m_dataPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Не удалось сохранить данные локального сервера:" << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(QJsonObject{ { "revision", m_revision }, { "entries", entries } }).toJson());
+    file.commit();
+}
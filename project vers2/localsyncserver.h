@@ -0,0 +1,77 @@
+#ifndef LOCALSYNCSERVER_H
+#define LOCALSYNCSERVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QList>
+#include <QPair>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+class QUrl;
+
+// Локальный заменитель сервера событий для проверки синхронизации без сети.
+// Понимает тот же REST, что и NetworkSync: GET/POST /events, PUT/DELETE /events/<id>,
+// POST /events/sync (events - upsert пакетом).
+// Каждое изменение получает номер ревизии; GET с since=<ревизия> отдаёт только
+// более поздние изменения (удаления - надгробиями), ETag - текущая ревизия.
+// Тела запросов - JSON или CBOR по Content-Type; ответ в CBOR, если его просит Accept.
+// Тела в обе стороны могут быть сжаты (Content-Encoding: deflate).
+// GET /events/stream - подписка (Server-Sent Events): сначала пропущенное после
+// since/Last-Event-ID, потом каждое изменение по мере появления.
+// Данные хранятся в JSON-файле, поэтому курсор клиента переживает перезапуск.
+class LocalSyncServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LocalSyncServer(const QString& dataPath, QObject* parent = nullptr);
+
+    bool listen(quint16 port);
+    quint16 port() const;
+    qint64 revision() const { return m_revision; }
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+private:
+    struct Entry {
+        QJsonObject json;
+        qint64 revision = 0;
+        bool deleted = false;
+    };
+    typedef QList<QPair<QByteArray, QByteArray>> Headers;
+
+    QTcpServer* m_server;
+    QString m_dataPath;
+    QHash<QString, Entry> m_entries;
+    qint64 m_revision;
+    bool m_deflateReply; // Текущий запрос принимает сжатый ответ
+    QHash<QTcpSocket*, QByteArray> m_buffers; // Недочитанные запросы соединений
+    QList<QTcpSocket*> m_subscribers;         // Соединения с открытой подпиской
+    QTimer* m_keepAlive;
+
+    void handleRequest(QTcpSocket* socket, const QByteArray& method, const QUrl& url,
+        const QHash<QByteArray, QByteArray>& headers, const QByteArray& body);
+    void listEvents(QTcpSocket* socket, const QUrl& url, const QByteArray& ifNoneMatch, bool cbor);
+    void subscribe(QTcpSocket* socket, const QUrl& url, const QByteArray& lastEventId);
+    QByteArray streamMessage(const QString& id, const Entry& entry) const;
+    void pushTo(QTcpSocket* socket, const QByteArray& message);
+    void broadcast(const QByteArray& message);
+    QString upsert(QJsonObject json);
+    bool removeEvent(const QString& id);
+    QByteArray etag() const;
+
+    void send(QTcpSocket* socket, int status, const QByteArray& body = QByteArray(),
+        const Headers& headers = Headers(), const QByteArray& contentType = "application/json");
+    void sendObject(QTcpSocket* socket, int status, const QJsonObject& object, bool cbor,
+        const Headers& headers = Headers());
+    void load();
+    void save() const;
+};
+
+#endif // LOCALSYNCSERVER_H
@@ -2,6 +2,9 @@
 #include "ui_mainwindow.h"
 #include "eventdialog.h"
 #include "settingsdialog.h"
+#include "jsoneventreader.h"
+#include "eventitemdelegate.h"
+#include "eventsnapshot.h"
 #include <QMessageBox>
 #include <QFile>
 #include <QJsonDocument>
@@ -15,28 +18,79 @@
 #include <QSettings>
 #include <QPixmap>
 
+namespace {
+    // Последнее известное состояние серверной коллекции - основа для загрузки изменений
+    const char* const kServerCachePath = "server.snap";
+    const int kServerSnapshotDelayMs = 2000; // Изменения из подписки за это время - одна запись
+
+    // Попадает ли день в диапазон из уведомления хранилища (невалидные границы открыты)
+    bool rangeContains(const QDate& from, const QDate& to, const QDate& date)
+    {
+        return (!from.isValid() || date >= from) && (!to.isValid() || date <= to);
+    }
+}
+
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
     , m_networkSync(new NetworkSync(this))
+    , m_standInServer(nullptr)
+    , m_outbox(new SyncOutbox("outbox.json", m_networkSync, this))
+    , m_journal(new EventJournal("events.snap", "events.journal", this))
+    , m_eventsModel(new EventListModel(&m_store, this))
     , m_connectedToServer(false)
     , m_trayIcon(nullptr)
     , m_notificationTimer(nullptr)
+    , m_refreshTimer(new QTimer(this))
+    , m_pendingRefresh(0)
+    , m_refreshRequests(0)
+    , m_refreshesPerformed(0)
+    , m_serverSnapshotTimer(new QTimer(this))
 {
     ui->setupUi(this);
+
+    // Все запросы обновления за один проход цикла событий сливаются в одно
+    m_refreshTimer->setSingleShot(true);
+    m_refreshTimer->setInterval(0);
+    connect(m_refreshTimer, &QTimer::timeout, this, &MainWindow::performRefresh);
+
+    m_serverSnapshotTimer->setSingleShot(true);
+    m_serverSnapshotTimer->setInterval(kServerSnapshotDelayMs);
+    connect(m_serverSnapshotTimer, &QTimer::timeout, this, [this]() {
+        if (saveServerSnapshot()) {
+            m_networkSync->commitSyncCursor();
+        }
+    });
     QIcon appIcon("icon.png");
     if (!appIcon.isNull()) {
         setWindowIcon(appIcon);
     }
 
-    m_localEvents = QVector<Event>();
-    m_serverEvents = QVector<Event>();
-
     m_connectedToServer = m_networkSync->isConnected();
     ui->statusBar->showMessage(m_connectedToServer ? "На сервере" : "Локально");
 
     connect(ui->calendarWidget, &QCalendarWidget::clicked, this, &MainWindow::onCalendarClicked);
-    connect(ui->eventsList, &QListWidget::itemSelectionChanged, this, &MainWindow::onEventSelected);
+    ui->calendarWidget->setEventStore(&m_store);
+
+    // Виды обновляются по уведомлениям хранилища - только затронутые дни
+    connect(&m_store, &EventStore::eventsAdded, this, &MainWindow::onStoreEventsChanged);
+    connect(&m_store, &EventStore::eventsChanged, this, &MainWindow::onStoreEventsChanged);
+    connect(&m_store, &EventStore::eventsRemoved, this, &MainWindow::onStoreEventsRemoved);
+
+    // Неделя и лента: выбор дня в них переключает день списка
+    ui->weekView->setEventStore(&m_store);
+    ui->agendaView->setEventStore(&m_store);
+    ui->weekView->setAnchorDate(ui->calendarWidget->selectedDate());
+    ui->agendaView->setAnchorDate(ui->calendarWidget->selectedDate());
+    connect(ui->weekView, &WeekView::dateClicked, this, &MainWindow::onTimelineDateClicked);
+    connect(ui->agendaView, &AgendaView::dateClicked, this, &MainWindow::onTimelineDateClicked);
+
+    // Список дня - модель поверх хранилища, строки рисует делегат
+    ui->eventsList->setModel(m_eventsModel);
+    ui->eventsList->setItemDelegate(new EventItemDelegate(ui->eventsList));
+    ui->eventsList->setUniformItemSizes(true);
+    connect(ui->eventsList->selectionModel(), &QItemSelectionModel::selectionChanged,
+        this, &MainWindow::onEventSelected);
     connect(ui->addButton, &QPushButton::clicked, this, &MainWindow::onAddButtonClicked);
     connect(ui->editButton, &QPushButton::clicked, this, &MainWindow::onEditButtonClicked);
     connect(ui->deleteButton, &QPushButton::clicked, this, &MainWindow::onDeleteButtonClicked);
@@ -48,6 +102,12 @@ MainWindow::MainWindow(QWidget* parent)
     connect(m_networkSync, &NetworkSync::syncStarted, this, &MainWindow::onSyncStarted);
     connect(m_networkSync, &NetworkSync::syncFinished, this, &MainWindow::onSyncFinished);
     connect(m_networkSync, &NetworkSync::eventsDownloaded, this, &MainWindow::onEventsDownloaded);
+    connect(m_networkSync, &NetworkSync::downloadCompleted, this, &MainWindow::onDownloadCompleted);
+    connect(m_networkSync, &NetworkSync::changesPushed, this, &MainWindow::onChangesPushed);
+    connect(m_networkSync, &NetworkSync::downloadProgress, this, &MainWindow::onDownloadProgress);
+    connect(m_outbox, &SyncOutbox::flushed, this, &MainWindow::onOutboxFlushed);
+    connect(m_outbox, &SyncOutbox::flushFailed, this, &MainWindow::onOutboxFailed);
+    connect(m_outbox, &SyncOutbox::operationRejected, this, &MainWindow::onOutboxRejected);
 
     // Меню
     connect(ui->actionSettings_3, &QAction::triggered, this, &MainWindow::onSettingsActionTriggered);
@@ -59,19 +119,38 @@ MainWindow::MainWindow(QWidget* parent)
     ui->deleteButton->setEnabled(false);
 
     // Файл
+    m_journal->setLegacySnapshotPath("events.json");
+    m_journal->setSnapshotProvider([this]() { return m_store.events(Event::Local); });
+    m_networkSync->setLocalIdsProvider([this]() {
+        QSet<QString> ids;
+        for (const Event& event : m_store.all()) {
+            if (event.source() == Event::Local) {
+                ids.insert(event.id());
+            }
+        }
+        return ids;
+    });
     loadEventsFromFile();
-    updateEventsList();
-    updateCalendarColors();
+    scheduleRefresh(RefreshList | RefreshCalendar);
 
     setupNotifications();//Уведомления
 
+    startStandInServerIfEnabled();
     autoSyncIfEnabled();
 }
 
 MainWindow::~MainWindow()
 {
-    // Сохранение только локальных событий при выходе
-    saveEventsToFile();
+    // Сжатие журнала локальных событий в снимок при выходе
+    m_journal->close();
+
+    qDebug() << "UI refresh:" << m_refreshRequests << "requests," << m_refreshesPerformed
+        << "performed," << (m_refreshRequests - m_refreshesPerformed) << "avoided";
+
+    // Изменения из подписки, ещё не попавшие в копию серверных событий
+    if (m_serverSnapshotTimer->isActive() && saveServerSnapshot()) {
+        m_networkSync->commitSyncCursor();
+    }
 
     if (m_networkSync) {
         disconnect(m_networkSync, nullptr, this, nullptr);
@@ -82,8 +161,15 @@ MainWindow::~MainWindow()
 
 void MainWindow::onCalendarClicked(const QDate& date)
 {
-    Q_UNUSED(date);
-    updateEventsList();
+    ui->weekView->setAnchorDate(date);
+    ui->agendaView->setAnchorDate(date);
+    scheduleRefresh(RefreshList);
+}
+
+void MainWindow::onTimelineDateClicked(const QDate& date)
+{
+    ui->calendarWidget->setSelectedDate(date);
+    scheduleRefresh(RefreshList);
 }
 
 //-==========================-
@@ -91,17 +177,13 @@ void MainWindow::onCalendarClicked(const QDate& date)
 //-==========================-
 void MainWindow::onEventSelected()
 {
-    QList<QListWidgetItem*> selectedItems = ui->eventsList->selectedItems();
-    bool hasSelection = !selectedItems.isEmpty();
+    QModelIndexList selected = ui->eventsList->selectionModel()->selectedIndexes();
+    bool hasSelection = !selected.isEmpty();
     ui->editButton->setEnabled(hasSelection);
     ui->deleteButton->setEnabled(hasSelection);
 
     if (hasSelection) {
-        QListWidgetItem* item = selectedItems.first();
-        if (item) {
-            Event event = item->data(Qt::UserRole).value<Event>();
-            showEventDetails(event);
-        }
+        showEventDetails(m_eventsModel->eventAt(selected.first().row()));
     }
     else {
         ui->eventDetails->clear();
@@ -115,6 +197,7 @@ void MainWindow::onAddButtonClicked()
 {
     EventDialog dialog(this);
     dialog.setWindowTitle("Добавление события");
+    dialog.setEventStore(&m_store);
     QDate selectedDate = ui->calendarWidget->selectedDate();
     QDateTime startDateTime(selectedDate, QTime(9, 0));
     QDateTime endDateTime = startDateTime.addSecs(3600);
@@ -124,29 +207,19 @@ void MainWindow::onAddButtonClicked()
         Event newEvent = dialog.getEvent();
 
         if (m_connectedToServer && m_networkSync->isConnected()) {
-            try {
-                newEvent.setSource(Event::Server);
-                m_networkSync->uploadSingleEvent(newEvent);
-                m_serverEvents.append(newEvent); // Добавляем локально сразу
-                ui->statusBar->showMessage("Событие отправляется на сервер...", 3000);
-            }
-            catch (...) {
-                // Если ошибка при отправке, сохраняем локально
-                newEvent.setSource(Event::Local);
-                m_localEvents.append(newEvent);
-                saveEventsToFile();
-                ui->statusBar->showMessage("Ошибка отправки, событие сохранено локально", 3000);
-            }
+            // Очередь отправки сохранит событие, даже если сервер сейчас недоступен
+            newEvent.setSource(Event::Server);
+            m_store.add(newEvent); // Добавляем локально сразу
+            m_outbox->enqueueCreate(newEvent);
+            ui->statusBar->showMessage("Событие отправляется на сервер...", 3000);
         }
         else {
             newEvent.setSource(Event::Local);
-            m_localEvents.append(newEvent);
-            saveEventsToFile();
+            m_store.add(newEvent);
+            m_journal->appendAdd(newEvent);
             ui->statusBar->showMessage("Событие сохранено локально", 3000);
         }
 
-        updateEventsList();
-        updateCalendarColors();
     }
 }
 
@@ -155,51 +228,45 @@ void MainWindow::onAddButtonClicked()
 //-==========================-
 void MainWindow::onEditButtonClicked()
 {
-    QListWidgetItem* item = ui->eventsList->currentItem();
-    if (!item) return;
+    Event oldEvent;
+    if (!currentEvent(oldEvent)) return;
 
-    Event oldEvent = item->data(Qt::UserRole).value<Event>();
-
-    // Определяем, в каком массиве искать событие
-    QVector<Event>* targetEvents = (oldEvent.source() == Event::Local) ?
-        &m_localEvents : &m_serverEvents;
+    // Для вхождения повторяющегося события редактируем всю серию
+    const Event* stored = m_store.find(oldEvent.id(), oldEvent.source());
+    if (stored) {
+        oldEvent = *stored;
+    }
 
     EventDialog dialog(this);
     dialog.setWindowTitle("Edit Event");
     dialog.setEvent(oldEvent);
+    dialog.setEventStore(&m_store);
 
     if (dialog.exec() == QDialog::Accepted) {
         Event updatedEvent = dialog.getEvent();
         updatedEvent.setId(oldEvent.id());
         updatedEvent.setSource(oldEvent.source()); // Сохраняем источник
 
-        // Находим событие в соответствующем массиве
-        for (int i = 0; i < targetEvents->size(); ++i) {
-            if (targetEvents->at(i).id() == oldEvent.id()) {
-                (*targetEvents)[i] = updatedEvent;
-                updateEventsList();
-
-                if (oldEvent.source() == Event::Local) {
-                    saveEventsToFile(); // Сохраняем только локальные
-                }
-
-                updateCalendarColors();
-
-                // Автоматическое обновление на сервере, если это серверное событие
-                if (oldEvent.source() == Event::Server && m_connectedToServer) {
-                    m_networkSync->updateEvent(updatedEvent);
-                    // Сообщение будет показано через сигнал syncFinished/errorOccurred
-                }
-                else if (oldEvent.source() == Event::Local && m_connectedToServer) {
-                    // Если редактируем локальное событие при подключении к серверу,
-                    // отправляем обновление на сервер
-                    m_networkSync->uploadSingleEvent(updatedEvent);
-                    ui->statusBar->showMessage("Событие сохранено с сервером", 3000);
-                }
-                else {
-                    ui->statusBar->showMessage("Событие сохранено", 3000);
-                }
-                break;
+        // Заменяем событие по индексу id
+        if (m_store.update(updatedEvent)) {
+
+            if (oldEvent.source() == Event::Local) {
+                m_journal->appendUpdate(updatedEvent); // Журналируем только локальные
+            }
+
+            // Правка серверного события уходит через очередь, даже без подключения
+            if (oldEvent.source() == Event::Server) {
+                m_outbox->enqueueUpsert(updatedEvent);
+                ui->statusBar->showMessage("Изменение поставлено в очередь отправки", 3000);
+            }
+            else if (oldEvent.source() == Event::Local && m_connectedToServer) {
+                // Если редактируем локальное событие при подключении к серверу,
+                // отправляем обновление на сервер
+                m_outbox->enqueueUpsert(updatedEvent);
+                ui->statusBar->showMessage("Событие сохранено с сервером", 3000);
+            }
+            else {
+                ui->statusBar->showMessage("Событие сохранено", 3000);
             }
         }
     }
@@ -210,39 +277,29 @@ void MainWindow::onEditButtonClicked()
 //-==========================-
 void MainWindow::onDeleteButtonClicked()
 {
-    QListWidgetItem* item = ui->eventsList->currentItem();
-    if (!item) return;
-
-    Event eventToDelete = item->data(Qt::UserRole).value<Event>();
+    Event eventToDelete;
+    if (!currentEvent(eventToDelete)) return;
     QString eventId = eventToDelete.id();
     QString eventName = eventToDelete.title();
 
+    if (eventToDelete.isRecurring()) {
+        deleteOccurrence(eventToDelete);
+        return;
+    }
+
     if (QMessageBox::question(this, "Удаление события",
         QString("Точно хочешь удалить? (╯°益°)╯彡┻━ '%1'").arg(eventName)) == QMessageBox::Yes) {
 
-        // Определяем, в каком массиве удалять
-        QVector<Event>* targetEvents = (eventToDelete.source() == Event::Local) ?
-            &m_localEvents : &m_serverEvents;
-
-        for (int i = 0; i < targetEvents->size(); ++i) {
-            if (targetEvents->at(i).id() == eventId) {
-                targetEvents->removeAt(i);
-                break;
-            }
-        }
-
-        updateEventsList();
+        m_store.remove(eventId, eventToDelete.source());
 
         if (eventToDelete.source() == Event::Local) {
-            saveEventsToFile(); // Сохраняем только локальные
+            m_journal->appendRemove(eventId); // Журналируем только локальные
         }
 
-        updateCalendarColors();
-
-        // Автоматическое удаление на сервере, если подключены
-        if (m_connectedToServer) {
-            m_networkSync->deleteEvent(eventId);
-            // Сообщение будет показано через сигнал syncFinished/errorOccurred
+        // Удаление серверного события уходит через очередь, даже без подключения
+        if (eventToDelete.source() == Event::Server || m_connectedToServer) {
+            m_outbox->enqueueRemove(eventId, eventToDelete.source());
+            ui->statusBar->showMessage("Удаление поставлено в очередь отправки", 3000);
         }
         else {
             ui->statusBar->showMessage("Событие удалено", 3000);
@@ -250,6 +307,51 @@ void MainWindow::onDeleteButtonClicked()
     }
 }
 
+//-==========================-
+// Удаление вхождения или всей серии повторяющегося события
+//-==========================-
+void MainWindow::deleteOccurrence(const Event& occurrence)
+{
+    const Event* stored = m_store.find(occurrence.id(), occurrence.source());
+    if (!stored) return;
+    Event master = *stored;
+
+    QMessageBox::StandardButton answer = QMessageBox::question(this, "Удаление события",
+        QString("'%1' повторяется. Удалить только это вхождение (%2)?\n"
+            "\"Нет\" удалит всю серию.")
+        .arg(master.title(), occurrence.start().date().toString("dd.MM.yyyy")),
+        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+
+    if (answer == QMessageBox::Cancel) return;
+
+    if (answer == QMessageBox::Yes) {
+        // Вхождение становится исключением в правиле повторения
+        Recurrence recurrence = master.recurrence();
+        recurrence.addException(occurrence.start().date());
+        master.setRecurrence(recurrence);
+        m_store.update(master);
+
+        if (master.source() == Event::Local) {
+            m_journal->appendUpdate(master);
+        }
+        else {
+            m_outbox->enqueueUpsert(master);
+        }
+    }
+    else {
+        m_store.remove(master.id(), master.source());
+
+        if (master.source() == Event::Local) {
+            m_journal->appendRemove(master.id());
+        }
+        if (master.source() == Event::Server || m_connectedToServer) {
+            m_outbox->enqueueRemove(master.id(), master.source());
+        }
+    }
+
+    ui->statusBar->showMessage("Событие удалено", 3000);
+}
+
 //-==========================-
 // Синхронизация с сервером
 //-==========================-
@@ -264,29 +366,144 @@ void MainWindow::onSyncButtonClicked()
     qDebug() << "Синхронизация с сервером" << m_networkSync->isConnected();
     ui->statusBar->showMessage("Подключение к серверу...");
 
+    // Явная синхронизация снимает паузу очереди и отправляет её без отсрочки
+    m_outbox->flush();
     m_networkSync->downloadEvents();
 }
 
 //-==========================-
-// Обработка загруженных событий
+// Обработка загруженных событий (одна партия)
 //-==========================-
-void MainWindow::onEventsDownloaded(const QVector<Event>& downloadedEvents)
+void MainWindow::onEventsDownloaded(const QVector<Event>& serverEvents, const QStringList& removedIds,
+    const QStringList& duplicateLocalIds, bool replaceAll)
 {
-    // Очищаем старые серверные события и добавляем новые
-    m_serverEvents.clear();
-    for (const Event& event : downloadedEvents) {
-        Event serverEvent = event;
-        serverEvent.setSource(Event::Server); // Помечаем как серверное
-        m_serverEvents.append(serverEvent);
+    // Партия разобрана и сверена с локальными событиями в рабочем потоке -
+    // здесь остаётся только применить её к хранилищу
+    for (const QString& id : duplicateLocalIds) {
+        if (m_store.remove(id, Event::Local)) {
+            m_journal->appendRemove(id);
+        }
     }
 
-    // Обновляем интерфейс
-    updateEventsList();
-    updateCalendarColors();
-    ui->statusBar->showMessage("Событие с сервера было скачано", 3000);
+    if (replaceAll) {
+        // Полный список заменяет старые серверные события
+        m_store.clear(Event::Server);
+    }
+    else {
+        // Изменения: удаляем надгробия, остальное добавляется или заменяется по id
+        for (const QString& id : removedIds) {
+            m_store.remove(id, Event::Server);
+        }
+    }
+    // Интерфейс обновится по сигналам хранилища, не дожидаясь конца загрузки
+    m_store.addAll(serverEvents);
+}
+
+//-==========================-
+// Загрузка с сервера завершена
+//-==========================-
+void MainWindow::onDownloadCompleted(int changed, int removed, bool fullSync)
+{
+    // Курсор загрузки NetworkSync сохранит сам, после этого обработчика
+    saveServerSnapshot();
+    applyPendingOutbox();
+
+    // Завершение синхронизации NetworkSync сообщает сам - второй syncFinished
+    // лишь повторил бы слияние и перерисовку
+    if (fullSync) {
+        ui->statusBar->showMessage("Событие с сервера было скачано", 3000);
+    }
+    else {
+        ui->statusBar->showMessage(QString("С сервера: изменено %1, удалено %2")
+            .arg(changed).arg(removed), 3000);
+    }
+}
+
+//-==========================-
+// Изменения из подписки: применяются сразу, на диск - одной записью за серию
+//-==========================-
+void MainWindow::onChangesPushed(const QVector<Event>& events, const QStringList& removedIds,
+    const QStringList& duplicateLocalIds)
+{
+    onEventsDownloaded(events, removedIds, duplicateLocalIds, false);
+
+    // Неотправленные правки накладываются снова только на пришедшие события
+    QStringList ids = removedIds;
+    for (const Event& event : events) {
+        ids.append(event.id());
+    }
+    applyPendingOutbox(ids);
+
+    if (!m_serverSnapshotTimer->isActive()) {
+        m_serverSnapshotTimer->start();
+    }
+    ui->statusBar->showMessage(QString("С сервера: изменено %1, удалено %2")
+        .arg(events.size()).arg(removedIds.size()), 3000);
+}
+
+//-==========================-
+// Копия серверных событий для следующего запроса изменений
+//-==========================-
+bool MainWindow::saveServerSnapshot()
+{
+    m_serverSnapshotTimer->stop();
+
+    // Без сохранённой копии коллекции следующий запрос изменений не к чему применить
+    if (!EventSnapshot::write(kServerCachePath, m_store.events(Event::Server))) {
+        qDebug() << "Не удалось сохранить серверные события";
+        m_networkSync->resetSyncState();
+        return false;
+    }
+    return true;
+}
+
+//-==========================-
+// Результаты отправки очереди
+//-==========================-
+void MainWindow::onOutboxFlushed(int sent)
+{
+    ui->statusBar->showMessage(QString("Отправлено на сервер изменений: %1").arg(sent), 3000);
+
+    // Очередь пуста - забираем то, что сервер сделал из наших изменений
+    if (m_outbox->isEmpty()) {
+        m_networkSync->downloadEvents();
+    }
+}
 
-    // Уведомляем о завершении синхронизации
-    emit m_networkSync->syncFinished(true, "Скачалось");
+void MainWindow::onOutboxFailed(const QString& message, bool willRetry)
+{
+    // Изменения остаются в очереди в любом случае
+    if (willRetry) {
+        ui->statusBar->showMessage(QString("Изменения не отправлены (%1), повтор позже").arg(message), 5000);
+    }
+    else {
+        ui->statusBar->showMessage(QString("Сервер отклонил изменения (%1), они сохранены до следующей синхронизации")
+            .arg(message), 5000);
+    }
+}
+
+void MainWindow::onOutboxRejected(const QString& id, const QString& message)
+{
+    ui->statusBar->showMessage(QString("Сервер отклонил изменение события %1 (%2), оно перенесено в outbox.json.rejected")
+        .arg(id, message), 8000);
+
+    // Отклонённая правка осталась в хранилище - следующая загрузка будет полной
+    // и вернёт серверную версию
+    m_networkSync->resetSyncState();
+    if (m_outbox->isEmpty()) {
+        m_networkSync->downloadEvents();
+    }
+}
+
+void MainWindow::onDownloadProgress(qint64 received, qint64 total)
+{
+    // Без Content-Length (chunked) показываем принятый объём
+    if (total > 0) {
+        ui->statusBar->showMessage(QString("Загрузка событий: %1%").arg(received * 100 / total));
+    }
+    else {
+        ui->statusBar->showMessage(QString("Загрузка событий: %1 КБ").arg(received / 1024));
+    }
 }
 
 //-==========================-
@@ -294,37 +511,95 @@ void MainWindow::onEventsDownloaded(const QVector<Event>& downloadedEvents)
 //-==========================-
 void MainWindow::updateCalendarColors()
 {
-    // Создаем карту дат с событиями
-    QMap<QDate, QColor> dateColors;
+    // Кэши видов сбрасываются целиком только при смене источника; правки
+    // событий приходят сигналами хранилища и сбрасывают лишь свои дни
+    Event::Source source = m_connectedToServer ? Event::Server : Event::Local;
+    if (ui->calendarWidget->setEventSource(source)) {
+        ui->calendarWidget->invalidateAll();
+    }
+    if (ui->weekView->setEventSource(source)) {
+        ui->weekView->invalidate();
+    }
+    if (ui->agendaView->setEventSource(source)) {
+        ui->agendaView->invalidate();
+    }
+}
+
+//-==========================-
+// Отложенное обновление: помечаем устаревшие виды, перерисовка - одна на проход
+//-==========================-
+void MainWindow::scheduleRefresh(int flags)
+{
+    m_refreshRequests += qPopulationCount(quint32(flags)); // Считаем по видам
+    m_pendingRefresh |= flags;
+    if (!m_refreshTimer->isActive()) {
+        m_refreshTimer->start();
+    }
+}
 
-    if (m_connectedToServer) {
-        // Если подключены к серверу, используем только серверные события
-        for (const Event& event : m_serverEvents) {
-            QDate eventDate = event.start().date();
-            dateColors[eventDate] = event.color();
-        }
+void MainWindow::performRefresh()
+{
+    int flags = m_pendingRefresh;
+    m_pendingRefresh = 0;
+    if (flags == 0) return;
+
+    // Календарь первым: список дня зависит от выбранной даты и источника
+    if (flags & RefreshCalendar) {
+        updateCalendarColors();
+        ++m_refreshesPerformed;
+    }
+    if (flags & RefreshList) {
+        updateEventsList();
+        ++m_refreshesPerformed;
+    }
+}
+
+//-==========================-
+// Уведомления хранилища: перерисовываем только затронутые дни
+//-==========================-
+void MainWindow::onStoreEventsChanged(const QStringList& ids, const QDate& from, const QDate& to)
+{
+    // Строки с прежним ключом остаются на месте - перерисовать только их
+    m_eventsModel->updateEvents(ids);
+
+    if (from.isValid()) {
+        ui->calendarWidget->invalidateDays(from, to);
     }
     else {
-        // Если не подключены к серверу, используем только локальные события
-        for (const Event& event : m_localEvents) {
-            QDate eventDate = event.start().date();
-            if (!dateColors.contains(eventDate) || dateColors[eventDate] == Qt::white) {
-                dateColors[eventDate] = event.color();
-            }
-        }
+        ui->calendarWidget->invalidateAll();
     }
+    ui->weekView->invalidateDays(from, to);
+    ui->agendaView->invalidateDays(from, to);
 
-    // Устанавливаем форматер дат для подсветки
-    ui->calendarWidget->setDateTextFormat(QDate(), QTextCharFormat()); // Сброс
+    if (rangeContains(from, to, ui->calendarWidget->selectedDate())) {
+        scheduleRefresh(RefreshList);
+    }
 
-    QTextCharFormat format;
-    format.setBackground(QBrush(Qt::lightGray));
-    format.setFontWeight(QFont::Bold);
+    // Событие могло попасть в окно напоминаний (после запуска таймера уведомлений)
+    QDate today = QDate::currentDate();
+    if (m_notificationTimer && (rangeContains(from, to, today) || rangeContains(from, to, today.addDays(1)))) {
+        QTimer::singleShot(0, this, &MainWindow::checkForEventNotifications);
+    }
+}
 
-    for (auto it = dateColors.begin(); it != dateColors.end(); ++it) {
-        format.setBackground(it.value());
-        ui->calendarWidget->setDateTextFormat(it.key(), format);
+void MainWindow::onStoreEventsRemoved(const QStringList& ids, const QDate& from, const QDate& to)
+{
+    // Состояние напоминаний удалённых событий больше не нужно
+    const QSet<QString> removed(ids.cbegin(), ids.cend());
+    for (const QString& id : ids) {
+        m_dismissedNotifications.remove(id);
     }
+    for (auto it = m_shownNotifications.begin(); it != m_shownNotifications.end();) {
+        // id уведомления: <id события>_<дата>_<тип>
+        if (removed.contains(it->section('_', 0, -3))) {
+            it = m_shownNotifications.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    onStoreEventsChanged(ids, from, to);
 }
 
 //-==========================-
@@ -346,12 +621,12 @@ void MainWindow::onErrorOccurred(const QString& error)
 
     ui->statusBar->showMessage("Ошибка: " + error, 5000);
     m_connectedToServer = false;
+    m_networkSync->stopPush();
 
     // Обновляем статус в UI
     ui->statusBar->showMessage(m_connectedToServer ? "На сервере" : "Локально");
 
-    updateEventsList();
-    updateCalendarColors();
+    scheduleRefresh(RefreshList | RefreshCalendar);
 }
 
 //-==========================-
@@ -382,10 +657,10 @@ void MainWindow::onExportActionTriggered()
         QJsonArray eventsArray;
 
         // Экспортируем и локальные и серверные события
-        for (const Event& event : m_localEvents) {
+        for (const Event& event : m_store.events(Event::Local)) {
             eventsArray.append(event.toJson());
         }
-        for (const Event& event : m_serverEvents) {
+        for (const Event& event : m_store.events(Event::Server)) {
             eventsArray.append(event.toJson());
         }
 
@@ -407,19 +682,25 @@ void MainWindow::onImportActionTriggered()
 
     QFile file(fileName);
     if (file.open(QIODevice::ReadOnly)) {
-        QByteArray data = file.readAll();
-        QJsonDocument doc = QJsonDocument::fromJson(data);
-        QJsonArray eventsArray = doc.array();
-
-        for (const QJsonValue& value : eventsArray) {
-            Event event = Event::fromJson(value.toObject());
+        // Читаем по одному объекту, не строя весь документ
+        JsonEventReader reader(&file);
+        Event event;
+        QVector<Event> imported;
+        JsonEventReader::Status status;
+        while ((status = reader.readNext(event)) == JsonEventReader::EventReady) {
             event.setSource(Event::Local); // Импортируем как локальные
-            m_localEvents.append(event);
+            imported.append(event);
+            m_journal->appendAdd(event);
         }
 
-        updateEventsList();
-        saveEventsToFile();
-        ui->statusBar->showMessage("Events imported successfully", 3000);
+        // Одной пачкой - одно уведомление для видов
+        m_store.addAll(imported);
+        if (status == JsonEventReader::Error) {
+            ui->statusBar->showMessage("Import stopped: " + reader.errorString(), 5000);
+        }
+        else {
+            ui->statusBar->showMessage("Events imported successfully", 3000);
+        }
     }
 }
 
@@ -444,8 +725,7 @@ void MainWindow::onSyncFinished(bool success, const QString& message)
         // Это нормально для операций добавления/обновления
         ui->statusBar->showMessage("Операция выполнена успешно", 3000);
         m_connectedToServer = true;
-        updateEventsList();
-        updateCalendarColors();
+        scheduleRefresh(RefreshList | RefreshCalendar);
         return;
     }
 
@@ -453,15 +733,14 @@ void MainWindow::onSyncFinished(bool success, const QString& message)
         ui->statusBar->showMessage("Sync completed: " + message, 3000);
         m_connectedToServer = true;
         mergeServerAndLocalEvents();
-        updateEventsList();
-        updateCalendarColors();
+        scheduleRefresh(RefreshList | RefreshCalendar);
     }
     else {
         QMessageBox::warning(this, "Sync Error", message);
         ui->statusBar->showMessage("Sync failed: " + message, 5000);
         m_connectedToServer = false;
-        updateEventsList();
-        updateCalendarColors();
+        m_networkSync->stopPush(); // Отключённое окно не слушает сервер
+        scheduleRefresh(RefreshList | RefreshCalendar);
     }
 
     ui->statusBar->showMessage(m_connectedToServer ? "Connected to server" : "Working offline");
@@ -484,51 +763,67 @@ void MainWindow::showEventDetails(const Event& event)
 }
 
 //-==========================-
-// Сохранение событий в файл
+// Загрузка событий: снимок + журнал изменений
 //-==========================-
-void MainWindow::saveEventsToFile()
+void MainWindow::loadEventsFromFile()
 {
-    QFile file("events.json");
-    if (file.open(QIODevice::WriteOnly)) {
-        QJsonArray eventsArray;
-        for (const Event& event : m_localEvents) { // Сохраняем только локальные
-            eventsArray.append(event.toJson());
-        }
+    QVector<Event> localEvents = m_journal->load();
+    for (Event& event : localEvents) {
+        event.setSource(Event::Local);
+    }
+    m_store.clear(Event::Local);
+    m_store.addAll(localEvents);
 
-        QJsonDocument doc(eventsArray);
-        file.write(doc.toJson());
-        file.close();
+    qDebug() << "Loaded" << m_store.count(Event::Local) << "local events";
+
+    // Серверные события с прошлой синхронизации; без них курсор недействителен
+    QVector<Event> serverEvents;
+    if (EventSnapshot::read(kServerCachePath, serverEvents)) {
+        for (Event& event : serverEvents) {
+            event.setSource(Event::Server);
+        }
+        m_store.clear(Event::Server);
+        m_store.addAll(serverEvents);
     }
+    else {
+        m_networkSync->resetSyncState();
+    }
+    applyPendingOutbox();
 }
 
 //-==========================-
-// Загрузка событий из файла
+// Неотправленные изменения поверх серверной копии
 //-==========================-
-void MainWindow::loadEventsFromFile()
+void MainWindow::applyPendingOutbox()
 {
-    QFile file("events.json");
-    if (file.open(QIODevice::ReadOnly)) {
-        QByteArray data = file.readAll();
-        QJsonDocument doc = QJsonDocument::fromJson(data);
-
-        if (doc.isArray()) {
-            QJsonArray eventsArray = doc.array();
-            m_localEvents.clear(); // Очищаем перед загрузкой
-
-            for (const QJsonValue& value : eventsArray) {
-                if (value.isObject()) {
-                    Event event = Event::fromJson(value.toObject());
-                    event.setSource(Event::Local);
-                    m_localEvents.append(event);
-                }
-            }
+    // Сервер ещё не знает об этих правках - загрузка не должна их откатывать
+    QVector<Event> pending;
+    for (const Event& event : m_outbox->pendingEvents()) {
+        if (event.source() == Event::Server) {
+            pending.append(event);
         }
-        file.close();
+    }
+    m_store.addAll(pending);
 
-        qDebug() << "Loaded" << m_localEvents.size() << "local events";
+    for (const QString& id : m_outbox->pendingRemovals(Event::Server)) {
+        m_store.remove(id, Event::Server);
     }
-    else {
-        qDebug() << "No local events file found";
+}
+
+void MainWindow::applyPendingOutbox(const QStringList& ids)
+{
+    QVector<Event> pending;
+    for (const Event& event : m_outbox->pendingEvents(ids)) {
+        if (event.source() == Event::Server) {
+            pending.append(event);
+        }
+    }
+    if (!pending.isEmpty()) {
+        m_store.addAll(pending);
+    }
+
+    for (const QString& id : m_outbox->pendingRemovals(Event::Server, ids)) {
+        m_store.remove(id, Event::Server);
     }
 }
 
@@ -538,8 +833,9 @@ void MainWindow::loadEventsFromFile()
 void MainWindow::onDisconnectButtonClicked()
 {
     m_connectedToServer = false;
-    updateEventsList();
-    updateCalendarColors();
+    m_outbox->setPaused(true); // Изменения копятся до следующей синхронизации
+    m_networkSync->stopPush();
+    scheduleRefresh(RefreshList | RefreshCalendar);
     ui->statusBar->showMessage("Disconnected from server", 3000);
 }
 
@@ -562,6 +858,24 @@ void MainWindow::autoSyncIfEnabled()
     }
 }
 
+//-==========================-
+// Локальный заменитель сервера (настройка server/standIn)
+//-==========================-
+void MainWindow::startStandInServerIfEnabled()
+{
+    QSettings settings;
+    if (!settings.value("server/standIn", false).toBool()) {
+        return;
+    }
+
+    // Адрес сервера в настройках должен указывать на http://localhost:<порт>/api
+    m_standInServer = new LocalSyncServer("standin_server.json", this);
+    const quint16 port = quint16(settings.value("server/standInPort", 3000).toUInt());
+    if (!m_standInServer->listen(port)) {
+        ui->statusBar->showMessage("Локальный сервер не запущен", 3000);
+    }
+}
+
 //-==========================-
 // Проверка включения автосинхронизации
 //-==========================-
@@ -576,96 +890,39 @@ bool MainWindow::autoSyncEnabled() const
 //-==========================-
 void MainWindow::mergeServerAndLocalEvents()
 {
-    // Удаляем локальные события, которые есть на сервере (чтобы избежать дублирования)
-    for (int i = m_localEvents.size() - 1; i >= 0; i--) {
-        for (const Event& serverEvent : m_serverEvents) {
-            if (m_localEvents[i].id() == serverEvent.id()) {
-                m_localEvents.removeAt(i);
-                break;
-            }
+    // Удаляем локальные события, которые есть на сервере (чтобы избежать дублирования).
+    // Загрузка уже убирает их по партиям; здесь - дубликаты от отправок, без копирования событий
+    QStringList duplicates;
+    for (const Event& event : m_store.all()) {
+        if (event.source() == Event::Local && m_store.contains(event.id(), Event::Server)) {
+            duplicates.append(event.id());
         }
     }
-
-    saveEventsToFile(); // Сохраняем обновленный список локальных событий
-}
-
-//-==========================-
-// Загрузка локальных событий на сервер (Потом)
-//-==========================-
-/*/
-void MainWindow::uploadLocalEventsToServer()
-{
-    if (!m_connectedToServer) {
-        QMessageBox::information(this, "Информация", "Не подключено к серверу");
-        return;
-    }
-    for (const Event& localEvent : m_localEvents) {
-        bool existsOnServer = false;
-        for (const Event& serverEvent : m_serverEvents) {
-            if (serverEvent.id() == localEvent.id()) {
-                existsOnServer = true;
-                break;
-            }
-        }
-        if (!existsOnServer) {
-            Event eventToUpload = localEvent;
-            eventToUpload.setSource(Event::Server);
-            m_networkSync->uploadSingleEvent(eventToUpload);
-            m_serverEvents.append(eventToUpload);
-        }
+    for (const QString& id : duplicates) {
+        m_journal->appendRemove(id);
+        m_store.remove(id, Event::Local);
     }
-    m_localEvents.clear();
-    saveEventsToFile();
-    updateEventsList();
-    updateCalendarColors();
-    ui->statusBar->showMessage("Локальное событие было загружено на сервер", 3000);
 }
-//*/
 
 //-==========================-
 // Обновление списка событий
 //-==========================-
 void MainWindow::updateEventsList()
 {
-    ui->eventsList->clear();
-    QDate selectedDate = ui->calendarWidget->selectedDate();
+    // Модель сама вычисляет вставленные и удалённые строки
+    m_eventsModel->showDate(ui->calendarWidget->selectedDate(), m_connectedToServer);
 
-    // Всегда показываем локальные события
-    for (const Event& event : m_localEvents) {
-        if (event.start().date() == selectedDate) {
-            QString itemText = QString("%1 - %2 (Локальное)")
-                .arg(event.start().time().toString("hh:mm"))
-                .arg(event.title());
-
-            QListWidgetItem* item = new QListWidgetItem(itemText);
-            item->setBackground(event.color());
-            item->setData(Qt::UserRole, QVariant::fromValue(event));
-            ui->eventsList->addItem(item);
-        }
-    }
-
-    // Показываем серверные события только если подключены
-    if (m_connectedToServer) {
-        for (const Event& event : m_serverEvents) {
-            if (event.start().date() == selectedDate) {
-                QString itemText = QString("%1 - %2 (Серверное)")
-                    .arg(event.start().time().toString("hh:mm"))
-                    .arg(event.title());
-
-                QListWidgetItem* item = new QListWidgetItem(itemText);
-                item->setBackground(event.color());
-                item->setData(Qt::UserRole, QVariant::fromValue(event));
-                ui->eventsList->addItem(item);
-            }
-        }
-    }
+    // Выделенная строка могла измениться или исчезнуть - обновляем детали и кнопки
+    onEventSelected();
+}
 
-    // Сбрасываем выделение кнопок, если список пуст
-    if (ui->eventsList->count() == 0) {
-        ui->editButton->setEnabled(false);
-        ui->deleteButton->setEnabled(false);
-        ui->eventDetails->clear();
-    }
+//-==========================-
+// Событие текущей строки списка
+//-==========================-
+bool MainWindow::currentEvent(Event& event) const
+{
+    QModelIndex index = ui->eventsList->currentIndex();
+    return index.isValid() && m_eventsModel->eventAt(index.row(), event);
 }
 
 //-==========================-
@@ -702,8 +959,12 @@ void MainWindow::checkForEventNotifications()
     QDateTime now = QDateTime::currentDateTime();
     QSet<QString> notifiedEvents; // Чтобы избежать повторных уведомлений
 
+    // Уведомления бывают только за [-1 мин, +10 мин] до начала - берём это окно
+    QDateTime windowFrom = now.addSecs(-60);
+    QDateTime windowTo = now.addSecs(601);
+
     // Проверяем локальные события
-    for (const Event& event : m_localEvents) {
+    for (const Event& event : m_store.eventsInRange(windowFrom, windowTo, Event::Local)) {
         if (shouldNotifyEvent(event, now) && !notifiedEvents.contains(event.id())) {
             showEventNotification(event, getNotificationMessage(event, now));
             notifiedEvents.insert(event.id());
@@ -711,7 +972,7 @@ void MainWindow::checkForEventNotifications()
     }
 
     // Проверяем серверные события
-    for (const Event& event : m_serverEvents) {
+    for (const Event& event : m_store.eventsInRange(windowFrom, windowTo, Event::Server)) {
         if (shouldNotifyEvent(event, now) && !notifiedEvents.contains(event.id())) {
             showEventNotification(event, getNotificationMessage(event, now));
             notifiedEvents.insert(event.id());
@@ -9,7 +9,12 @@
 #include <QMap>
 #include <QSet>
 #include "event.h"
+#include "eventstore.h"
 #include "networksync.h"
+#include "eventjournal.h"
+#include "eventlistmodel.h"
+#include "localsyncserver.h"
+#include "syncoutbox.h"
 
 #ifdef Q_OS_WIN
 #include <windows.h>
@@ -28,8 +33,13 @@ public:
     MainWindow(QWidget* parent = nullptr);
     ~MainWindow();
 
+    //    :  ( )  
+    qint64 refreshRequests() const { return m_refreshRequests; }
+    qint64 refreshesPerformed() const { return m_refreshesPerformed; }
+
 private slots:
     void onCalendarClicked(const QDate& date);
+    void onTimelineDateClicked(const QDate& date);
     void onEventSelected();
     void onAddButtonClicked();
     void onEditButtonClicked();
@@ -43,22 +53,55 @@ private slots:
 
     void onSyncStarted();
     void onSyncFinished(bool success, const QString& message);
-    void onEventsDownloaded(const QVector<Event>& events);
+    void onEventsDownloaded(const QVector<Event>& events, const QStringList& removedIds,
+        const QStringList& duplicateLocalIds, bool replaceAll);
+    void onDownloadCompleted(int changed, int removed, bool fullSync);
+    void onChangesPushed(const QVector<Event>& events, const QStringList& removedIds,
+        const QStringList& duplicateLocalIds);
+    void onDownloadProgress(qint64 received, qint64 total);
+    void onOutboxFlushed(int sent);
+    void onOutboxFailed(const QString& message, bool willRetry);
+    void onOutboxRejected(const QString& id, const QString& message);
+    void performRefresh();
+    void onStoreEventsChanged(const QStringList& ids, const QDate& from, const QDate& to);
+    void onStoreEventsRemoved(const QStringList& ids, const QDate& from, const QDate& to);
 
 private:
+    // ,        
+    enum RefreshFlag {
+        RefreshList = 0x1,
+        RefreshCalendar = 0x2
+    };
+
     Ui::MainWindow* ui;
-    QVector<Event> m_localEvents;
-    QVector<Event> m_serverEvents;
+    EventStore m_store;
     NetworkSync* m_networkSync;
+    LocalSyncServer* m_standInServer;
+    SyncOutbox* m_outbox;
+    EventJournal* m_journal;
+    EventListModel* m_eventsModel;
     QSystemTrayIcon* m_trayIcon; 
     QTimer* m_notificationTimer;
     bool m_connectedToServer;
 
+    //   
+    QTimer* m_refreshTimer;
+    int m_pendingRefresh;
+    qint64 m_refreshRequests;
+    qint64 m_refreshesPerformed;
+
+    //         ,    
+    QTimer* m_serverSnapshotTimer;
+
     // 
     QMap<QString, QDateTime> m_dismissedNotifications;
     QSet<QString> m_shownNotifications;
 
     void autoSyncIfEnabled();
+    void startStandInServerIfEnabled();
+    void applyPendingOutbox();
+    void applyPendingOutbox(const QStringList& ids);
+    bool saveServerSnapshot();
     void mergeServerAndLocalEvents();
     void setupNotifications();
     void checkForEventNotifications();
@@ -71,8 +114,10 @@ private:
     void updateEventsList();
     bool autoSyncEnabled() const;
     void showEventDetails(const Event& event);
-    void saveEventsToFile();
     void loadEventsFromFile();
     void updateCalendarColors();
+    void deleteOccurrence(const Event& occurrence);
+    void scheduleRefresh(int flags);
+    bool currentEvent(Event& event) const;
 };
 #endif // MAINWINDOW_H
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include "monthview.h"
+#include "eventstore.h"
+#include <QPainter>
+#include <algorithm>
+
+namespace {
+    const int kGridDays = 6 * 7;    // Календарь всегда показывает шесть недель
+    const int kCachedPages = 3;     // Текущая страница и соседние при листании
+    const int kChipSpacing = 2;
+    const int kDotSize = 6;
+}
+
+MonthView::MonthView(QWidget* parent)
+    : QCalendarWidget(parent)
+    , m_store(nullptr)
+    , m_source(Event::Local)
+    , m_loadedPage(-1)
+{
+    connect(this, &QCalendarWidget::currentPageChanged, this, &MonthView::onPageChanged);
+}
+
+void MonthView::setEventStore(const EventStore* store)
+{
+    m_store = store;
+    invalidateAll();
+}
+
+bool MonthView::setEventSource(Event::Source source)
+{
+    if (m_source == source) return false;
+    m_source = source;
+    return true;
+}
+
+// Невалидный to - до конца (бессрочная серия повторов)
+void MonthView::invalidateDays(const QDate& from, const QDate& toDate)
+{
+    if (!from.isValid()) return;
+    const QDate to = toDate.isValid() ? toDate : QDate(9999, 12, 31);
+
+    // Дни за пределами видимой сетки будут посчитаны при переходе на их страницу
+    QDate first = qMax(from, m_gridStart);
+    QDate last = qMin(to, m_gridStart.addDays(kGridDays - 1));
+    bool visible = m_loadedPage == currentPage() && first <= last;
+
+    for (auto page = m_cellCache.begin(); page != m_cellCache.end(); ++page) {
+        page.value().removeIf([&from, &to](const QHash<QDate, Cell>::iterator& it) {
+            return it.key() >= from && it.key() <= to;
+            });
+    }
+
+    // Другие страницы раскладываются заново при показе
+    if (!visible) return;
+
+    for (QDate date = first; date <= last; date = date.addDays(1)) {
+        m_dayChips.remove(date);
+        if (m_store) {
+            for (const Event& event : m_store->eventsForDate(date, m_source)) {
+                addChips(event, date, date);
+            }
+        }
+        auto chips = m_dayChips.find(date);
+        if (chips != m_dayChips.end()) {
+            std::sort(chips.value().begin(), chips.value().end(), [](const Chip& a, const Chip& b) {
+                return a.startMs < b.startMs;
+                });
+        }
+        updateCell(date);
+    }
+}
+
+void MonthView::invalidateAll()
+{
+    m_loadedPage = -1;
+    m_dayChips.clear();
+    m_cellCache.clear();
+    updateCells();
+}
+
+int MonthView::currentPage() const
+{
+    return yearShown() * 12 + monthShown() - 1;
+}
+
+QDate MonthView::gridStart() const
+{
+    QDate monthStart(yearShown(), monthShown(), 1);
+    int offset = (monthStart.dayOfWeek() - firstDayOfWeek() + 7) % 7;
+    if (offset == 0) {
+        offset = 7; // Сверху всегда целая неделя предыдущего месяца
+    }
+    return monthStart.addDays(-offset);
+}
+
+//-==========================-
+// Один запрос к хранилищу на всю видимую сетку
+//-==========================-
+void MonthView::ensurePageLoaded() const
+{
+    int page = currentPage();
+    if (m_loadedPage == page) return;
+
+    m_loadedPage = page;
+    m_gridStart = gridStart();
+    m_dayChips.clear();
+    if (!m_store) return;
+
+    QDate gridEnd = m_gridStart.addDays(kGridDays - 1);
+    const QVector<Event> events = m_store->eventsInRange(m_gridStart.startOfDay(),
+        gridEnd.addDays(1).startOfDay(), m_source);
+    for (const Event& event : events) {
+        addChips(event, m_gridStart, gridEnd);
+    }
+    for (auto it = m_dayChips.begin(); it != m_dayChips.end(); ++it) {
+        std::sort(it.value().begin(), it.value().end(), [](const Chip& a, const Chip& b) {
+            return a.startMs < b.startMs;
+            });
+    }
+}
+
+// Плашка на каждый день события в пределах [from, to]
+void MonthView::addChips(const Event& event, const QDate& from, const QDate& to) const
+{
+    if (!event.start().isValid()) return;
+
+    QDate first = event.start().date();
+    QDate last = event.end() > event.start() ? event.end().addMSecs(-1).date() : first;
+    first = qMax(first, from);
+    last = qMin(last, to);
+
+    const Chip chip = { event.start().toMSecsSinceEpoch(), event.color().rgba(), event.title() };
+    for (QDate date = first; date <= last; date = date.addDays(1)) {
+        m_dayChips[date].append(chip);
+    }
+}
+
+//-==========================-
+// Ячейка рисуется из кэша; перерисовка только при смене состояния или размера
+//-==========================-
+void MonthView::paintCell(QPainter* painter, const QRect& rect, QDate date) const
+{
+    ensurePageLoaded();
+
+    const qreal ratio = painter->device() ? painter->device()->devicePixelRatioF() : 1.0;
+    const bool selected = date == selectedDate();
+    const bool inMonth = date.year() == yearShown() && date.month() == monthShown();
+
+    Cell& cell = m_cellCache[currentPage()][date];
+    if (cell.pixmap.isNull() || cell.size != rect.size() || cell.selected != selected
+        || cell.inMonth != inMonth || !qFuzzyCompare(cell.pixmap.devicePixelRatio(), ratio)) {
+        cell.size = rect.size();
+        cell.selected = selected;
+        cell.inMonth = inMonth;
+        renderCell(cell, date, ratio);
+    }
+    painter->drawPixmap(rect.topLeft(), cell.pixmap);
+}
+
+void MonthView::renderCell(Cell& cell, const QDate& date, qreal ratio) const
+{
+    cell.pixmap = QPixmap(cell.size * ratio);
+    cell.pixmap.setDevicePixelRatio(ratio);
+
+    const QPalette& pal = palette();
+    cell.pixmap.fill(cell.selected ? pal.color(QPalette::Highlight) : pal.color(QPalette::Base));
+
+    QPainter p(&cell.pixmap);
+    p.setRenderHint(QPainter::Antialiasing);
+    QRect rect(QPoint(0, 0), cell.size);
+
+    // Сегодняшний день - рамкой
+    if (date == QDate::currentDate()) {
+        p.setPen(QPen(pal.color(QPalette::Highlight).darker(120), 2));
+        p.drawRect(rect.adjusted(1, 1, -1, -1));
+    }
+
+    // Номер дня
+    QColor textColor = cell.selected ? pal.color(QPalette::HighlightedText) : pal.color(QPalette::Text);
+    if (!cell.inMonth) {
+        textColor.setAlphaF(0.4f);
+    }
+    QFont dayFont = font();
+    p.setFont(dayFont);
+    p.setPen(textColor);
+    const int dayHeight = QFontMetrics(dayFont).height();
+    p.drawText(rect.adjusted(3, 1, -3, 0), Qt::AlignTop | Qt::AlignRight, QString::number(date.day()));
+
+    auto it = m_dayChips.constFind(date);
+    if (it == m_dayChips.constEnd() || it.value().isEmpty()) return;
+    const QVector<Chip>& chips = it.value();
+
+    QFont chipFont = font();
+    chipFont.setPointSizeF(chipFont.pointSizeF() * 0.75);
+    QFontMetrics chipMetrics(chipFont);
+    const int chipHeight = chipMetrics.height() + 2;
+    QRect area = rect.adjusted(2, dayHeight + 1, -2, -2);
+
+    if (area.height() >= chipHeight) {
+        // Плашки с названиями, сколько поместится; остаток - "+N"
+        const int fit = qMax(1, (area.height() + kChipSpacing) / (chipHeight + kChipSpacing));
+        const int shown = chips.size() > fit ? fit - 1 : chips.size();
+        p.setFont(chipFont);
+        int y = area.top();
+        for (int i = 0; i < shown; ++i) {
+            QColor color = QColor::fromRgba(chips[i].color);
+            QRect chipRect(area.left(), y, area.width(), chipHeight);
+            p.setPen(Qt::NoPen);
+            p.setBrush(color);
+            p.drawRoundedRect(chipRect, 3, 3);
+            p.setPen(color.lightness() > 150 ? Qt::black : Qt::white);
+            p.drawText(chipRect.adjusted(3, 0, -2, 0), Qt::AlignVCenter | Qt::AlignLeft,
+                chipMetrics.elidedText(chips[i].title, Qt::ElideRight, chipRect.width() - 5));
+            y += chipHeight + kChipSpacing;
+        }
+        if (shown < chips.size()) {
+            p.setPen(textColor);
+            p.drawText(QRect(area.left(), y, area.width(), chipHeight), Qt::AlignVCenter | Qt::AlignLeft,
+                QString("+%1").arg(chips.size() - shown));
+        }
+    }
+    else {
+        // Мелкая ячейка - цветные точки в ряд
+        const int maxDots = qMax(1, rect.width() / (kDotSize + kChipSpacing));
+        int x = rect.left() + 3;
+        int y = rect.bottom() - kDotSize - 2;
+        p.setPen(Qt::NoPen);
+        for (int i = 0; i < chips.size() && i < maxDots; ++i) {
+            p.setBrush(QColor::fromRgba(chips[i].color));
+            p.drawEllipse(QRect(x, y, kDotSize, kDotSize));
+            x += kDotSize + kChipSpacing;
+        }
+    }
+}
+
+//-==========================-
+// Смена страницы: держим в кэше только несколько ближайших месяцев
+//-==========================-
+void MonthView::onPageChanged()
+{
+    const int page = currentPage();
+    for (auto it = m_cellCache.begin(); it != m_cellCache.end();) {
+        if (qAbs(it.key() - page) >= kCachedPages) {
+            it = m_cellCache.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
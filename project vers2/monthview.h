@@ -0,0 +1,66 @@
+#ifndef MONTHVIEW_H
+#define MONTHVIEW_H
+
+#include <QCalendarWidget>
+#include <QHash>
+#include <QPixmap>
+#include <QVector>
+#include "event.h"
+
+class EventStore;
+
+// Месячная сетка с событиями, нарисованными в ячейках (плашки или точки).
+// События видимой страницы раскладываются по дням одним запросом к хранилищу,
+// готовые ячейки кэшируются в QPixmap по страницам месяца; изменение события
+// сбрасывает только затронутые дни.
+class MonthView : public QCalendarWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MonthView(QWidget* parent = nullptr);
+
+    void setEventStore(const EventStore* store);
+    // true, если источник сменился; сбросить кэш вида - забота вызывающего
+    bool setEventSource(Event::Source source);
+
+    void invalidateDays(const QDate& from, const QDate& to);
+    void invalidateAll();
+
+protected:
+    void paintCell(QPainter* painter, const QRect& rect, QDate date) const override;
+
+private:
+    struct Chip {
+        qint64 startMs;
+        QRgb color;
+        QString title;
+    };
+
+    struct Cell {
+        QPixmap pixmap;
+        QSize size;
+        bool selected;
+        bool inMonth;
+    };
+
+    const EventStore* m_store;
+    Event::Source m_source;
+
+    // Раскладка событий по дням видимой сетки
+    mutable int m_loadedPage;
+    mutable QDate m_gridStart;
+    mutable QHash<QDate, QVector<Chip>> m_dayChips;
+
+    // Кэш отрисованных ячеек: страница месяца -> день -> картинка
+    mutable QHash<int, QHash<QDate, Cell>> m_cellCache;
+
+    int currentPage() const;
+    QDate gridStart() const;
+    void ensurePageLoaded() const;
+    void addChips(const Event& event, const QDate& from, const QDate& to) const;
+    void renderCell(Cell& cell, const QDate& date, qreal ratio) const;
+    void onPageChanged();
+};
+
+#endif // MONTHVIEW_H
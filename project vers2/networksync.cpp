@@ -1,18 +1,54 @@
 #include "networksync.h"
+#include "jsoneventreader.h"
 #include <QNetworkRequest>
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QCborValue>
 #include <QSettings>
+#include <QUrlQuery>
+#include <QTimer>
+#include <QRandomGenerator>
+#include <QtConcurrent/QtConcurrentRun>
 
-NetworkSync::NetworkSync(QObject* parent) : QObject(parent)
+namespace {
+    // Событий в одной партии загрузки - интерфейс успевает отрисоваться между партиями
+    const int kDownloadBatchSize = 500;
+    // Тела меньше не сжимаем - выигрыш не окупает заголовки и время
+    const int kCompressThreshold = 1024;
+    const int kDefaultMaxInFlight = 4;
+    // Сколько ответ может молчать, пока запрос не сочтут зависшим:
+    // правка пользователя, синхронизация, фоновая очередь
+    const int kTransferTimeoutMs[] = { 15000, 60000, 30000 };
+    // Полный срок запроса с постановки в очередь - вместе с ожиданием в ней
+    const int kDeadlineMs[] = { 30000, 5 * 60 * 1000, 2 * 60 * 1000 };
+    // Сервер шлёт комментарий раз в 15 с; тишина дольше - соединение оборвано
+    const int kStreamTimeoutMs = 45000;
+    const int kStreamRetryMs = 2000;
+    const int kStreamRetryMaxMs = 60 * 1000;
+}
+
+NetworkSync::NetworkSync(QObject* parent)
+    : QObject(parent), m_stateGeneration(0), m_deadlineTimer(new QTimer(this))
+    , m_serverCbor(false), m_compressBodies(true)
+    , m_stream(nullptr), m_streamTimer(new QTimer(this)), m_streamAttempt(0), m_streamRetryMs(kStreamRetryMs)
 {
     m_networkManager = new QNetworkAccessManager(this);
     QSettings settings;
     m_serverUrl = settings.value("server/url", "http://localhost:3000/api").toString();
     m_authToken = settings.value("server/token").toString();
-    connect(m_networkManager, &QNetworkAccessManager::finished,
-        this, &NetworkSync::onDownloadFinished);
+    m_syncCursor = settings.value("sync/cursor").toString();
+    m_etag = settings.value("sync/etag").toByteArray();
+    m_cborEnabled = settings.value("sync/cbor", true).toBool();
+    m_maxInFlight = qMax(1, settings.value("sync/maxRequests", kDefaultMaxInFlight).toInt());
+    m_pushEnabled = settings.value("sync/push", true).toBool();
+
+    m_streamTimer->setSingleShot(true);
+    connect(m_streamTimer, &QTimer::timeout, this, &NetworkSync::startStream);
+
+    m_clock.start();
+    m_deadlineTimer->setSingleShot(true);
+    connect(m_deadlineTimer, &QTimer::timeout, this, &NetworkSync::expireRequests);
 }
 
 NetworkSync::~NetworkSync()
@@ -22,6 +58,9 @@ NetworkSync::~NetworkSync()
 
 void NetworkSync::setServerUrl(const QString& url)          //URL  -=========================
 {
+    if (url != m_serverUrl) {
+        resetSyncState(); // Курсор относится к прежнему серверу
+    }
     m_serverUrl = url;
     QSettings settings;
     settings.setValue("server/url", url); // Сохранение в настройках
@@ -29,11 +68,32 @@ void NetworkSync::setServerUrl(const QString& url)          //URL  -============
 
 void NetworkSync::setAuthToken(const QString& token)        //Токен -=========================
 {
+    if (token != m_authToken) {
+        resetSyncState(); // Другая учётная запись - другая коллекция
+    }
     m_authToken = token;
     QSettings settings;
     settings.setValue("server/token", token); // Сохранение в настройках
 }
 
+void NetworkSync::setCborEnabled(bool enabled)
+{
+    m_cborEnabled = enabled;
+    if (!enabled) {
+        m_serverCbor = false;
+    }
+    QSettings settings;
+    settings.setValue("sync/cbor", enabled);
+}
+
+void NetworkSync::setMaxInFlight(int count)
+{
+    m_maxInFlight = qMax(1, count);
+    QSettings settings;
+    settings.setValue("sync/maxRequests", m_maxInFlight);
+    dispatchQueued();
+}
+
 void NetworkSync::syncEvents(const QVector<Event>& events)  //Сервер синхронизация
 {
     emit syncStarted();
@@ -42,25 +102,68 @@ void NetworkSync::syncEvents(const QVector<Event>& events)  //Сервер си
 
 void NetworkSync::downloadEvents()
 {
+    if (m_download) {
+        qDebug() << "Загрузка событий уже идёт";
+        return;
+    }
+
     QUrl serverUrl(m_serverUrl + "/events");
     if (!serverUrl.isValid()) {
         emit errorOccurred("Неправильный URL " + m_serverUrl);
         return;
     }
+
+    // С курсором сервер отдаёт только изменения после него
+    const bool delta = !m_syncCursor.isEmpty();
+    if (delta) {
+        QUrlQuery query;
+        query.addQueryItem("since", m_syncCursor);
+        serverUrl.setQuery(query);
+    }
     qDebug() << "Подключение к :" << serverUrl.toString();
 
-    QNetworkRequest request(serverUrl);
-    if (!m_authToken.isEmpty()) {
-        request.setRawHeader("Authorization", "Bearer " + m_authToken.toUtf8());
-        qDebug() << "Использование токена";
+    QNetworkRequest request = makeRequest(serverUrl);
+    // Коллекция не менялась - сервер ответит 304 без тела
+    if (!m_etag.isEmpty()) {
+        request.setRawHeader("If-None-Match", m_etag);
+    }
+    // Сервер без CBOR просто ответит в JSON
+    if (m_cborEnabled) {
+        request.setRawHeader("Accept", "application/cbor, application/json;q=0.9");
     }
+    // Accept-Encoding не задаём сами: его ставит QNetworkAccessManager и тогда же
+    // прозрачно распаковывает gzip/deflate. Заданный вручную заголовок отключает
+    // распаковку, и разборщик получил бы сжатые байты.
 
-    QNetworkReply* reply = m_networkManager->get(request);
-    if (!reply) {
-        emit errorOccurred("Не удалось создать сетевой запрос");
-        return;
+    // Загрузка сама приносит всё новое; подписка откроется заново с её курсора
+    stopPush();
+
+    // Загрузка заводится до отправки: запрос может уйти сразу, а может подождать в очереди
+    m_download.reset(new Download);
+    m_download->generation = m_stateGeneration;
+    m_download->delta = delta;
+    m_download->parser.reset(new DownloadParser);
+    m_download->parser->reader.setTombstonesEnabled(true);
+    m_download->parser->cborReader.setTombstonesEnabled(true);
+    if (m_localIdsProvider) {
+        m_download->parser->localIds = m_localIdsProvider();
     }
-    connect(reply, &QNetworkReply::errorOccurred, this, &NetworkSync::onErrorOccurred);
+    m_download->watcher = new QFutureWatcher<ParseResult>(this);
+    connect(m_download->watcher, &QFutureWatcher<ParseResult>::finished, this, &NetworkSync::onParseFinished);
+
+    send(RequestKind::Download, Priority::Sync, "download", QNetworkAccessManager::GetOperation,
+        request, QJsonValue(),
+        [this](QNetworkReply* reply) { handleDownloadReply(reply); },
+        [this](QNetworkReply* reply) { attachDownload(reply); });
+}
+
+void NetworkSync::attachDownload(QNetworkReply* reply)
+{
+    if (!m_download) return;
+
+    m_download->reply = reply;
+    connect(reply, &QNetworkReply::readyRead, this, &NetworkSync::onDownloadReadyRead);
+    connect(reply, &QNetworkReply::downloadProgress, this, &NetworkSync::downloadProgress);
     qDebug() << "Сетевой запрос запущен";
 }
 
@@ -69,200 +172,823 @@ void NetworkSync::downloadEvents()
 //-==========================-
 void NetworkSync::uploadEvents(const QVector<Event>& events)
 {
-    QNetworkRequest request(QUrl(m_serverUrl + "/events/sync"));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    QJsonObject payload;
+    payload["events"] = eventsToJsonArray(events);
+
+    send(RequestKind::Upload, Priority::Sync, "events/sync", QNetworkAccessManager::PostOperation,
+        makeRequest(QUrl(m_serverUrl + "/events/sync")), payload,
+        [this](QNetworkReply* reply) { handleUploadReply(reply); });
+}
 
+//-==========================-
+// Запрос и его обработчик
+//-==========================-
+QNetworkRequest NetworkSync::makeRequest(const QUrl& url) const
+{
+    QNetworkRequest request(url);
+    // Все запросы идут через один менеджер и переиспользуют его соединения
+    // (keep-alive); по HTTPS сервер может выбрать HTTP/2, и тогда они идут
+    // параллельно в одном соединении
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
     if (!m_authToken.isEmpty()) {
         request.setRawHeader("Authorization", "Bearer " + m_authToken.toUtf8());
     }
+    return request;
+}
 
-    QJsonObject payload;
-    payload["events"] = eventsToJsonArray(events);
+void NetworkSync::send(RequestKind kind, Priority priority, const QString& key,
+    QNetworkAccessManager::Operation operation, const QNetworkRequest& request,
+    const QJsonValue& payload, const ReplyHandler& handler, const ReplyHandler& started,
+    const FailHandler& failed)
+{
+    PendingRequest pending;
+    pending.kind = kind;
+    pending.priority = priority;
+    pending.key = key;
+    pending.handler = handler;
+    pending.started = started;
+    pending.failed = failed;
+    pending.operation = operation;
+    pending.request = request;
+    pending.payload = payload;
+    pending.deadline = m_clock.elapsed() + kDeadlineMs[int(priority)];
 
-    QNetworkReply* reply = m_networkManager->post(request, QJsonDocument(payload).toJson());
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() { onUploadFinished(reply); });
-    connect(reply, &QNetworkReply::errorOccurred, this, &NetworkSync::onErrorOccurred);
+    // Ждущий запрос к той же цели устарел - уйдёт только последний
+    if (!key.isEmpty()) {
+        cancelQueued(key);
+    }
+    m_queue[int(priority)].append(pending);
+    dispatchQueued();
+    armDeadlineTimer();
 }
 
 //-==========================-
-// Обработка завершения загрузки
+// Планировщик: старший приоритет первым, не больше m_maxInFlight в сети
 //-==========================-
-void NetworkSync::onUploadFinished(QNetworkReply* reply)
+void NetworkSync::dispatchQueued()
 {
-    int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    QString response = QString::fromUtf8(reply->readAll());
+    for (int priority = 0; priority < kPriorityCount; ++priority) {
+        QList<PendingRequest>& queue = m_queue[priority];
+        int index = 0;
+        while (index < queue.size() && m_pending.size() < m_maxInFlight) {
+            // Цель занята запросом в полёте - этот подождёт его ответа
+            if (isKeyInFlight(queue[index].key)) {
+                ++index;
+                continue;
+            }
+            start(queue.takeAt(index));
+        }
+    }
+}
+
+bool NetworkSync::isKeyInFlight(const QString& key) const
+{
+    if (key.isEmpty()) return false;
+
+    for (const PendingRequest& pending : m_pending) {
+        if (pending.key == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void NetworkSync::cancelQueued(const QString& key)
+{
+    for (QList<PendingRequest>& queue : m_queue) {
+        const qsizetype removed = queue.removeIf([&key](const PendingRequest& pending) {
+            return pending.key == key;
+        });
+        if (removed > 0) {
+            qDebug() << "Запрос заменён более новым:" << key;
+        }
+    }
+}
+
+//-==========================-
+// Сроки запросов: истёкший в очереди не отправляется, истёкший в полёте прерывается
+//-==========================-
+void NetworkSync::armDeadlineTimer()
+{
+    qint64 nearest = -1;
+    for (const PendingRequest& pending : m_pending) {
+        if (nearest < 0 || pending.deadline < nearest) nearest = pending.deadline;
+    }
+    for (const QList<PendingRequest>& queue : m_queue) {
+        for (const PendingRequest& pending : queue) {
+            if (nearest < 0 || pending.deadline < nearest) nearest = pending.deadline;
+        }
+    }
+
+    if (nearest < 0) {
+        m_deadlineTimer->stop();
+        return;
+    }
+    m_deadlineTimer->start(int(qMax<qint64>(0, nearest - m_clock.elapsed())));
+}
+
+void NetworkSync::expireRequests()
+{
+    const qint64 now = m_clock.elapsed();
+    const QString message = "Превышено время ожидания ответа от сервера";
+
+    for (QList<PendingRequest>& queue : m_queue) {
+        QList<PendingRequest> expired;
+        for (int index = 0; index < queue.size();) {
+            if (queue[index].deadline <= now) {
+                expired.append(queue.takeAt(index));
+            }
+            else {
+                ++index;
+            }
+        }
+        for (const PendingRequest& pending : expired) {
+            qDebug() << "Срок запроса истёк в очереди:" << int(pending.kind) << pending.key;
+            failQueued(pending, message);
+        }
+    }
+
+    // abort() синхронно выдаёт finished: ответ уходит обработчику как тайм-аут
+    QList<QNetworkReply*> overdue;
+    for (auto it = m_pending.constBegin(); it != m_pending.constEnd(); ++it) {
+        if (it->deadline <= now) {
+            overdue.append(it.key());
+        }
+    }
+    for (QNetworkReply* reply : overdue) {
+        qDebug() << "Срок запроса истёк в сети:" << int(m_pending.value(reply).kind);
+        reply->abort();
+    }
+
+    dispatchQueued();
+    armDeadlineTimer();
+}
+
+// Запрос так и не ушёл: сообщаем о неудаче так же, как сообщил бы его обработчик
+void NetworkSync::failQueued(const PendingRequest& pending, const QString& message)
+{
+    if (pending.failed) {
+        pending.failed(message);
+        return;
+    }
+
+    switch (pending.kind) {
+    case RequestKind::Download:
+        m_download.reset();
+        endDownload(false, message);
+        break;
+    case RequestKind::Batch:
+        emit batchUploaded(false, 0, message);
+        break;
+    default:
+        emit syncFinished(false, message);
+        break;
+    }
+}
+
+bool NetworkSync::start(PendingRequest pending)
+{
+    // Тело в CBOR - только серверу, который сам отвечал в CBOR
+    const bool hasBody = !pending.payload.isNull() && !pending.payload.isUndefined();
+    pending.cbor = hasBody && m_cborEnabled && m_serverCbor;
+    QNetworkRequest prepared(pending.request);
+    // Тайм-аут Qt ловит только зависание; общий срок следит expireRequests()
+    prepared.setTransferTimeout(kTransferTimeoutMs[int(pending.priority)]);
+    QByteArray body;
+    if (pending.cbor) {
+        prepared.setHeader(QNetworkRequest::ContentTypeHeader, "application/cbor");
+        body = QCborValue::fromJsonValue(pending.payload).toCbor();
+    }
+    else if (hasBody) {
+        prepared.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+        body = QJsonDocument(pending.payload.toObject()).toJson(QJsonDocument::Compact);
+    }
+
+    // qCompress - поток zlib с 4 байтами длины впереди; без них это deflate по HTTP
+    pending.bodyBytes = body.size();
+    pending.compressed = m_compressBodies && body.size() >= kCompressThreshold;
+    if (pending.compressed) {
+        body = qCompress(body).mid(4);
+        prepared.setRawHeader("Content-Encoding", "deflate");
+    }
+    pending.sentBytes = body.size();
 
-    qDebug() << "Загрузка завершена. Статус:" << statusCode << "Ответ:" << response;
+    QNetworkReply* reply = nullptr;
+    switch (pending.operation) {
+    case QNetworkAccessManager::GetOperation:
+        reply = m_networkManager->get(prepared);
+        break;
+    case QNetworkAccessManager::PostOperation:
+        reply = m_networkManager->post(prepared, body);
+        break;
+    case QNetworkAccessManager::PutOperation:
+        reply = m_networkManager->put(prepared, body);
+        break;
+    case QNetworkAccessManager::DeleteOperation:
+        reply = m_networkManager->deleteResource(prepared);
+        break;
+    default:
+        break;
+    }
+    if (!reply) {
+        if (pending.kind == RequestKind::Download) {
+            m_download.reset();
+        }
+        emit errorOccurred("Не удалось создать сетевой запрос");
+        return false;
+    }
+
+    m_pending.insert(reply, pending);
+    connect(reply, &QNetworkReply::finished, this, &NetworkSync::onReplyFinished);
+    if (pending.started) {
+        pending.started(reply);
+    }
+    return true;
+}
+
+//-==========================-
+// Единственная точка завершения: обработчик вызывается один раз
+//-==========================-
+void NetworkSync::onReplyFinished()
+{
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    auto it = m_pending.find(reply);
+    if (it == m_pending.end()) {
+        return; // Запрос уже отменён
+    }
+    const PendingRequest pending = it.value();
+    m_pending.erase(it);
+
+    const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    recordTraffic(pending, reply);
+    qDebug() << "Запрос завершён:" << int(pending.kind) << statusCode;
+
+    // Формат или сжатие не приняты - дальше без них, этот же запрос повторяем один раз
+    if (statusCode == 415 && (pending.cbor || pending.compressed)) {
+        qDebug() << "Сервер не принимает тело запроса, повтор в JSON без сжатия";
+        m_serverCbor = false;
+        m_compressBodies = false;
+        reply->deleteLater();
+        m_queue[int(pending.priority)].prepend(pending);
+        dispatchQueued();
+        return;
+    }
+
+    pending.handler(reply);
+    reply->deleteLater();
+    dispatchQueued();
+    armDeadlineTimer();
+}
+
+//-==========================-
+// Учёт байтов запроса и ответа
+//-==========================-
+void NetworkSync::recordTraffic(const PendingRequest& pending, QNetworkReply* reply)
+{
+    // Тело загрузки частично уже прочитано по ходу приёма
+    qint64 received = reply->bytesAvailable();
+    if (m_download && m_download->reply == reply) {
+        received += m_download->receivedBytes;
+    }
+    // Content-Length - размер в сети; после распаковки тело больше
+    bool ok = false;
+    qint64 wireReceived = reply->rawHeader("Content-Length").toLongLong(&ok);
+    if (!ok) {
+        wireReceived = received;
+    }
+
+    ++m_traffic.requests;
+    m_traffic.bodyBytes += pending.bodyBytes;
+    m_traffic.sentBytes += pending.sentBytes;
+    m_traffic.receivedBytes += received;
+    m_traffic.wireReceivedBytes += wireReceived;
+
+    qDebug() << "Трафик запроса: отправлено" << pending.sentBytes << "из" << pending.bodyBytes
+             << "байт, получено" << wireReceived << "->" << received << "байт";
+}
+
+//-==========================-
+// Обработка завершения отправки
+//-==========================-
+void NetworkSync::handleUploadReply(QNetworkReply* reply)
+{
+    int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
     if (statusCode == 403) {
         emit syncFinished(false, "У вас нет прав для изменения событий на сервере");
     }
-    else if (statusCode == 201 || statusCode == 200) {
-        emit syncFinished(true, "Операция выполнена успешно");
-    }
     else if (reply->error() == QNetworkReply::NoError) {
+        // Тело ответа не нужно - события вернутся со следующей загрузкой
         emit syncFinished(true, "Операция выполнена успешно");
     }
     else {
-        emit syncFinished(false, reply->errorString() + ". Response: " + response);
+        emit syncFinished(false, errorMessage(reply));
     }
-    reply->deleteLater();
 }
 
-void NetworkSync::onDownloadFinished(QNetworkReply* reply)
+//-==========================-
+// Приём загрузки по частям
+//-==========================-
+void NetworkSync::onDownloadReadyRead()
 {
-    if (reply->error() == QNetworkReply::NoError) {
-        QByteArray response = reply->readAll();
-        QJsonDocument doc = QJsonDocument::fromJson(response);
+    if (!m_download || !m_download->reply) return;
+    QNetworkReply* reply = m_download->reply;
 
-        // Проверяем HTTP статус код
-        int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-        if (statusCode == 403) {
-            emit syncFinished(false, "Y BAC HET PRAV");
-            reply->deleteLater();
-            return;
+    // Тело 304 и ответов с ошибкой не разбираем - их обработает handleDownloadReply
+    const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (statusCode < 200 || statusCode >= 300) {
+        return;
+    }
+
+    if (!m_download->headersRead) {
+        // Полный список: первый запрос, сервер без курсоров или курсор сброшен сервером
+        m_download->cursor = QString::fromUtf8(reply->rawHeader("X-Sync-Cursor"));
+        m_download->etag = reply->rawHeader("ETag");
+        m_download->fullSync = !m_download->delta || m_download->cursor.isEmpty()
+            || reply->rawHeader("X-Sync-Full") == "1";
+        m_download->replacePending = m_download->fullSync;
+        m_download->headersRead = true;
+
+        // Разбор ещё не начат - формат можно выбрать здесь
+        const bool cbor = reply->header(QNetworkRequest::ContentTypeHeader).toString()
+            .startsWith("application/cbor", Qt::CaseInsensitive);
+        m_download->parser->cbor = cbor;
+        if (cbor && m_cborEnabled) {
+            m_serverCbor = true;
         }
+    }
 
-        QVector<Event> downloadedEvents;
+    const QByteArray data = reply->readAll();
+    m_download->receivedBytes += data.size();
+    m_download->received.append(data);
+    startParse();
+}
 
-        if (doc.isArray()) {
-            // Если ответ - массив событий
-            downloadedEvents = jsonArrayToEvents(doc.array());
+//-==========================-
+// Разбор в пуле потоков: в работе не больше одного куска, остальные копятся
+//-==========================-
+void NetworkSync::startParse()
+{
+    if (!m_download || m_download->parsing) return;
+
+    const bool atEnd = m_download->transferDone;
+    if (m_download->received.isEmpty() && !atEnd) return;
+
+    QByteArray data = std::move(m_download->received);
+    m_download->received = QByteArray();
+    m_download->parsing = true;
+    m_download->watcher->setFuture(QtConcurrent::run(&NetworkSync::parseChunk,
+        m_download->parser, data, atEnd));
+}
+
+// JsonEventReader и CborEventReader отдают события одинаково
+template <class Reader>
+void NetworkSync::readEvents(Reader& reader, const QSet<QString>& localIds, bool atEnd, ParseResult& result)
+{
+    Event event;
+    typename Reader::Status status;
+    while ((status = reader.readNext(event)) == Reader::EventReady || status == Reader::Tombstone) {
+        if (status == Reader::Tombstone) {
+            result.removedIds.append(event.id());
         }
-        else if (doc.isObject()) {
-            // Если ответ - объект с полем events
-            QJsonObject responseObj = doc.object();
-            if (responseObj.contains("events") && responseObj["events"].isArray()) {
-                QJsonArray eventsArray = responseObj["events"].toArray();
-                downloadedEvents = jsonArrayToEvents(eventsArray);
+        else {
+            // Локальная копия серверного события - дубликат, его уберут вместе с партией
+            if (localIds.contains(event.id())) {
+                result.duplicateLocalIds.append(event.id());
             }
+            event.setSource(Event::Server);
+            result.events.append(event);
         }
+    }
+    if (atEnd && status == Reader::NeedMoreData) {
+        status = reader.finish();
+    }
+    result.failed = status == Reader::Error;
+    result.error = reader.errorString();
+}
+
+// Выполняется в рабочем потоке: трогает только разборщик, принадлежащий загрузке
+NetworkSync::ParseResult NetworkSync::parseChunk(QSharedPointer<DownloadParser> parser,
+    const QByteArray& data, bool atEnd)
+{
+    ParseResult result;
+    result.atEnd = atEnd;
+    if (parser->cbor) {
+        parser->cborReader.addData(data);
+        readEvents(parser->cborReader, parser->localIds, atEnd, result);
+    }
+    else {
+        parser->reader.addData(data);
+        readEvents(parser->reader, parser->localIds, atEnd, result);
+    }
+    return result;
+}
+
+void NetworkSync::onParseFinished()
+{
+    if (!m_download || sender() != m_download->watcher) return;
+
+    const ParseResult result = m_download->watcher->result();
+    m_download->parsing = false;
+    m_download->events += result.events;
+    m_download->removedIds += result.removedIds;
+    m_download->duplicateLocalIds += result.duplicateLocalIds;
 
-        if (!downloadedEvents.isEmpty()) {
-            emit eventsDownloaded(downloadedEvents);
-            emit syncFinished(true, "События успешно загружены");
+    if (result.failed) {
+        abortDownload();
+        endDownload(false, "Ошибка в ответе сервера: " + result.error);
+        return;
+    }
+
+    // Готовые партии сразу уходят в интерфейс
+    if (m_download->events.size() + m_download->removedIds.size() >= kDownloadBatchSize) {
+        if (!flushDownloadBatch()) {
+            return;
         }
-        //else {
-        //    emit syncFinished(false, "Никаких событий с сервера не получено");
-        //}
+    }
+
+    if (result.atEnd) {
+        completeDownload();
     }
     else {
-        // Обработка других ошибок
-        emit syncFinished(false, reply->errorString());
+        startParse();
+    }
+}
+
+bool NetworkSync::flushDownloadBatch()
+{
+    const QVector<Event> events = std::move(m_download->events);
+    const QStringList removedIds = std::move(m_download->removedIds);
+    const QStringList duplicateLocalIds = std::move(m_download->duplicateLocalIds);
+    const bool replaceAll = m_download->replacePending;
+    m_download->events = QVector<Event>();
+    m_download->removedIds = QStringList();
+    m_download->duplicateLocalIds = QStringList();
+    m_download->replacePending = false;
+    m_download->changed += events.size();
+    m_download->removed += removedIds.size();
+
+    emit eventsDownloaded(events, removedIds, duplicateLocalIds, replaceAll);
+
+    // Обработчик мог сбросить состояние синхронизации - загрузка тогда прервана
+    return !m_download.isNull();
+}
+
+void NetworkSync::abortDownload()
+{
+    if (!m_download) return;
+
+    // Сначала забываем загрузку: abort() синхронно выдаёт finished.
+    // Результат разбора, если он ещё идёт, вместе с наблюдателем отбрасывается.
+    QNetworkReply* reply = m_download->reply;
+    m_download.reset();
+    if (reply) {
+        m_pending.remove(reply);
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+        dispatchQueued();
+    }
+    else {
+        cancelQueued("download"); // Запрос ещё ждал в очереди
     }
-    reply->deleteLater();
+}
+
+void NetworkSync::handleDownloadReply(QNetworkReply* reply)
+{
+    if (!m_download || reply != m_download->reply) {
+        return;
+    }
+
+    if (reply->error() != QNetworkReply::NoError) {
+        // Обработка других ошибок; курсор остаётся прежним
+        m_download.reset();
+        endDownload(false, errorMessage(reply));
+        return;
+    }
+
+    // Проверяем HTTP статус код
+    int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (statusCode == 403) {
+        abortDownload();
+        endDownload(false, "Y BAC HET PRAV");
+        return;
+    }
+    if (statusCode == 304) {
+        abortDownload();
+        endDownload(true, "Изменений на сервере нет");
+        return;
+    }
+
+    // Остаток данных; ответ удаляется после обработчика, разбор его уже не трогает
+    m_download->transferDone = true;
+    onDownloadReadyRead();
+    m_download->reply = nullptr;
+    if (!m_download->headersRead) {
+        m_download.reset();
+        endDownload(false, QString("Ошибка в ответе сервера: HTTP %1").arg(statusCode));
+        return;
+    }
+    startParse();
 }
 
 //-==========================-
-// Отправка событий после загрузки
+// Все данные разобраны и отданы
 //-==========================-
-void NetworkSync::uploadEventsAfterDownload(const QVector<Event>& localEvents)
+void NetworkSync::completeDownload()
 {
-    // Отправляем только локальные события
-    QVector<Event> eventsToSend;
-    for (const Event& event : localEvents) {
-        if (event.source() == Event::Local) {
-            eventsToSend.append(event);
+    // Последняя неполная партия; пустой полный список тоже отдаётся - он очищает события
+    if (m_download->replacePending || !m_download->events.isEmpty() || !m_download->removedIds.isEmpty()) {
+        if (!flushDownloadBatch()) {
+            return;
         }
     }
 
-    QNetworkRequest request(QUrl(m_serverUrl + "/events/sync"));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    QScopedPointer<Download> download(m_download.take());
+    emit downloadCompleted(download->changed, download->removed, download->fullSync);
 
-    if (!m_authToken.isEmpty()) {
-        request.setRawHeader("Authorization", "Bearer " + m_authToken.toUtf8());
+    // Курсор запоминается только после применения изменений,
+    // и только если обработчик не сбросил состояние
+    if (download->generation == m_stateGeneration) {
+        m_syncCursor = download->cursor;
+        m_etag = download->etag;
+        saveSyncState();
     }
+    endDownload(true, "События успешно загружены");
+}
 
-    QJsonObject payload;
-    payload["events"] = eventsToJsonArray(eventsToSend);
+void NetworkSync::endDownload(bool success, const QString& message)
+{
+    emit syncFinished(success, message);
 
-    QNetworkReply* reply = m_networkManager->post(request, QJsonDocument(payload).toJson());
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() { onUploadFinished(reply); });
-    connect(reply, &QNetworkReply::errorOccurred, this, &NetworkSync::onErrorOccurred);
+    // Слушаем сервер только после успешной загрузки: после ошибки окно
+    // считает себя отключённым, и поток вернёт следующая удачная синхронизация
+    if (success) {
+        startStream();
+    }
 }
 
 //-==========================-
-// Удаление события с сервера
+// Подписка на изменения: Server-Sent Events
 //-==========================-
-void NetworkSync::deleteEvent(const QString& eventId)
+void NetworkSync::startStream()
 {
-    QNetworkRequest request(QUrl(m_serverUrl + "/events/" + eventId));
-    if (!m_authToken.isEmpty()) {
-        request.setRawHeader("Authorization", "Bearer " + m_authToken.toUtf8());
+    if (!m_pushEnabled || m_stream || m_download || m_syncCursor.isEmpty() || !isConnected()) {
+        return;
+    }
+    m_streamTimer->stop();
+
+    QUrl url(m_serverUrl + "/events/stream");
+    QUrlQuery query;
+    query.addQueryItem("since", m_syncCursor);
+    url.setQuery(query);
+
+    // Запрос не кончается - он идёт мимо очереди и не занимает место в m_maxInFlight
+    QNetworkRequest request = makeRequest(url);
+    request.setRawHeader("Accept", "text/event-stream");
+    request.setRawHeader("Cache-Control", "no-cache");
+    request.setRawHeader("Last-Event-ID", m_syncCursor.toUtf8());
+    request.setTransferTimeout(kStreamTimeoutMs);
+
+    m_streamBuffer.clear();
+    m_stream = m_networkManager->get(request);
+    connect(m_stream, &QNetworkReply::readyRead, this, &NetworkSync::onStreamReadyRead);
+    connect(m_stream, &QNetworkReply::finished, this, &NetworkSync::onStreamFinished);
+    qDebug() << "Подписка на изменения с курсора" << m_syncCursor;
+}
+
+void NetworkSync::stopPush()
+{
+    m_streamTimer->stop();
+    m_streamAttempt = 0;
+    m_streamBuffer.clear();
+    if (!m_stream) return;
+
+    QNetworkReply* stream = m_stream;
+    m_stream = nullptr;
+    disconnect(stream, nullptr, this, nullptr);
+    stream->abort();
+    stream->deleteLater();
+}
+
+void NetworkSync::onStreamReadyRead()
+{
+    if (!m_stream || sender() != m_stream) return;
+
+    // Тело ответа с ошибкой не разбираем - им займётся onStreamFinished
+    const int statusCode = m_stream->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (statusCode != 200) {
+        return;
     }
+    m_streamAttempt = 0; // Поток жив - следующий обрыв начнёт задержки сначала
 
-    QNetworkReply* reply = m_networkManager->deleteResource(request);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    m_streamBuffer.append(m_stream->readAll());
+    m_streamBuffer.replace("\r\n", "\n");
 
-        if (statusCode == 403) {
-            emit errorOccurred("У вас нет прав для удаления событий на сервере");
+    // Всё, что пришло одним куском, применяется одной партией
+    QVector<Event> events;
+    QStringList removedIds;
+    QString lastId;
+    bool reset = false;
+    int end;
+    while ((end = m_streamBuffer.indexOf("\n\n")) >= 0) {
+        const QByteArray block = m_streamBuffer.left(end);
+        m_streamBuffer.remove(0, end + 2);
+
+        QByteArray type = "message";
+        QByteArray data;
+        for (const QByteArray& line : block.split('\n')) {
+            // Строка с двоеточия - комментарий, им сервер поддерживает соединение
+            if (line.isEmpty() || line.startsWith(':')) continue;
+
+            const int colon = line.indexOf(':');
+            const QByteArray field = colon < 0 ? line : line.left(colon);
+            QByteArray value = colon < 0 ? QByteArray() : line.mid(colon + 1);
+            if (value.startsWith(' ')) {
+                value.remove(0, 1);
+            }
+
+            if (field == "event") {
+                type = value;
+            }
+            else if (field == "data") {
+                if (!data.isEmpty()) data += '\n';
+                data += value;
+            }
+            else if (field == "id") {
+                lastId = QString::fromUtf8(value);
+            }
+            else if (field == "retry") {
+                bool ok = false;
+                const int retryMs = value.toInt(&ok);
+                if (ok && retryMs > 0) {
+                    m_streamRetryMs = retryMs;
+                }
+            }
+        }
+
+        const QJsonObject object = QJsonDocument::fromJson(data).object();
+        if (type == "upsert" && !object.isEmpty()) {
+            Event event = Event::fromJson(object);
+            event.setSource(Event::Server);
+            events.append(event);
         }
-        else if (reply->error() == QNetworkReply::NoError) {
-            emit syncFinished(true, "Событие удалено");
+        else if (type == "delete") {
+            removedIds.append(object.value("id").toString());
         }
-        else {
-            emit syncFinished(false, reply->errorString());
+        else if (type == "reset") {
+            reset = true;
+            break;
         }
-        reply->deleteLater();
-        });
-    connect(reply, &QNetworkReply::errorOccurred, this, &NetworkSync::onErrorOccurred);
+    }
+
+    if (reset) {
+        // Сервер не знает нашего курсора (другие данные) - нужна полная загрузка
+        qDebug() << "Сервер сбросил подписку, полная загрузка";
+        resetSyncState();
+        downloadEvents();
+        return;
+    }
+
+    if (!events.isEmpty() || !removedIds.isEmpty()) {
+        // Локальные копии пришедших событий - дубликаты, как и при загрузке
+        QStringList duplicateLocalIds;
+        if (!events.isEmpty() && m_localIdsProvider) {
+            const QSet<QString> localIds = m_localIdsProvider();
+            for (const Event& event : events) {
+                if (localIds.contains(event.id())) {
+                    duplicateLocalIds.append(event.id());
+                }
+            }
+        }
+
+        const int generation = m_stateGeneration;
+        emit changesPushed(events, removedIds, duplicateLocalIds);
+        // Обработчик мог сбросить состояние - тогда курсор не трогаем
+        if (generation != m_stateGeneration) {
+            return;
+        }
+    }
+
+    // Переподключение продолжит с этого места; на диск курсор попадёт
+    // через commitSyncCursor(), вместе с сохранённой копией событий
+    if (!lastId.isEmpty()) {
+        m_syncCursor = lastId;
+    }
 }
 
-//-==========================-
-// Обновление события на сервере
-//-==========================-
-void NetworkSync::updateEvent(const Event& event)
+void NetworkSync::commitSyncCursor()
+{
+    saveSyncState();
+}
+
+void NetworkSync::onStreamFinished()
 {
-    QNetworkRequest request(QUrl(m_serverUrl + "/events/" + event.id()));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    QNetworkReply* stream = m_stream;
+    if (!stream || sender() != stream) return;
+    m_stream = nullptr;
+    stream->deleteLater();
 
-    if (!m_authToken.isEmpty()) {
-        request.setRawHeader("Authorization", "Bearer " + m_authToken.toUtf8());
+    // Сервер без подписки или без прав - переподключение не поможет
+    const int statusCode = stream->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (statusCode == 401 || statusCode == 403 || statusCode == 404
+        || statusCode == 405 || statusCode == 501) {
+        qDebug() << "Подписка на изменения недоступна: HTTP" << statusCode;
+        return;
     }
 
-    QJsonObject eventJson = event.toJson();
-    QNetworkReply* reply = m_networkManager->put(request, QJsonDocument(eventJson).toJson());
+    ++m_streamAttempt;
+    const int delay = streamReconnectDelay();
+    qDebug() << "Подписка прервана:" << stream->errorString() << "- повтор через" << delay << "мс";
+    m_streamTimer->start(delay);
+}
 
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        onUploadFinished(reply);
-        });
-    connect(reply, &QNetworkReply::errorOccurred, this, &NetworkSync::onErrorOccurred);
+// Экспоненциальная задержка с разбросом, как у очереди отправки
+int NetworkSync::streamReconnectDelay() const
+{
+    const int shift = qMin(m_streamAttempt - 1, 16);
+    const int delay = int(qMin<qint64>(qint64(m_streamRetryMs) << shift, kStreamRetryMaxMs));
+    return delay / 2 + int(QRandomGenerator::global()->bounded(delay / 2 + 1));
 }
 
 //-==========================-
-// Обработка сетевых ошибок
+// Отправка событий после загрузки
 //-==========================-
-void NetworkSync::onErrorOccurred(QNetworkReply::NetworkError code)
+void NetworkSync::uploadEventsAfterDownload(const QVector<Event>& localEvents)
 {
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-    if (!reply) return;
+    // Отправляем только локальные события
+    QVector<Event> eventsToSend;
+    for (const Event& event : localEvents) {
+        if (event.source() == Event::Local) {
+            eventsToSend.append(event);
+        }
+    }
+
+    QJsonObject payload;
+    payload["events"] = eventsToJsonArray(eventsToSend);
+
+    send(RequestKind::Upload, Priority::Sync, "events/sync", QNetworkAccessManager::PostOperation,
+        makeRequest(QUrl(m_serverUrl + "/events/sync")), payload,
+        [this](QNetworkReply* reply) { handleUploadReply(reply); });
+}
 
+//-==========================-
+// Понятный текст сетевой ошибки
+//-==========================-
+QString NetworkSync::errorMessage(QNetworkReply* reply) const
+{
     int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    QString errorMessage;
+    QString message;
     if (statusCode == 403) {
-        errorMessage = "У вас нет прав для выполнения этой операции на сервере";
+        message = "У вас нет прав для выполнения этой операции на сервере";
     }
     else if (statusCode == 401) {
-        errorMessage = "Неверный токен авторизации";
+        message = "Неверный токен авторизации";
     }
     else if (statusCode == 404) {
-        errorMessage = "Сервер не найден или недоступен";
+        message = "Сервер не найден или недоступен";
     }
     else {
-        errorMessage = reply->errorString();
-        if (errorMessage.contains("Connection refused")) {
-            errorMessage = "Не удалось подключиться к серверу. Проверьте URL и доступность сервера";
+        message = reply->errorString();
+        if (message.contains("Connection refused")) {
+            message = "Не удалось подключиться к серверу. Проверьте URL и доступность сервера";
         }
-        else if (errorMessage.contains("Host not found")) {
-            errorMessage = "Сервер не найден. Проверьте правильность URL";
+        else if (message.contains("Host not found")) {
+            message = "Сервер не найден. Проверьте правильность URL";
         }
-        else if (errorMessage.contains("Timeout")) {
-            errorMessage = "Превышено время ожидания ответа от сервера";
+        else if (message.contains("Timeout") || reply->error() == QNetworkReply::OperationCanceledError
+            || reply->error() == QNetworkReply::TimeoutError) {
+            message = "Превышено время ожидания ответа от сервера";
         }
     }
+    return message;
+}
 
-    emit errorOccurred(errorMessage);
+//-==========================-
+// Состояние инкрементальной синхронизации
+//-==========================-
+void NetworkSync::resetSyncState()
+{
+    // Ответы на уже отправленные запросы станут устаревшими
+    ++m_stateGeneration;
+    if (m_download) {
+        abortDownload();
+        emit syncFinished(false, "Загрузка прервана: изменились настройки сервера");
+    }
+    // Поддержку CBOR и сжатия новый сервер покажет сам
+    m_serverCbor = false;
+    m_compressBodies = true;
+    m_syncCursor.clear();
+    m_etag.clear();
+    saveSyncState();
+    stopPush(); // Подписка шла с прежнего курсора
+}
+
+void NetworkSync::saveSyncState()
+{
+    QSettings settings;
+    settings.setValue("sync/cursor", m_syncCursor);
+    settings.setValue("sync/etag", m_etag);
 }
 
 QJsonArray NetworkSync::eventsToJsonArray(const QVector<Event>& events)
@@ -273,34 +999,57 @@ QJsonArray NetworkSync::eventsToJsonArray(const QVector<Event>& events)
     }
     return array;
 }
-QVector<Event> NetworkSync::jsonArrayToEvents(const QJsonArray& jsonArray)
+
+//-==========================-
+// Отправка пакета изменений
+//-==========================-
+void NetworkSync::uploadBatch(const QJsonArray& events, bool interactive)
 {
-    QVector<Event> events;
-    for (const QJsonValue& value : jsonArray) {
-        events.append(Event::fromJson(value.toObject()));
-    }
-    return events;
+    QJsonObject payload;
+    payload["events"] = events;
+
+    // Ошибки не идут в errorOccurred: очередь сама решает, повторять ли отправку
+    send(RequestKind::Batch, interactive ? Priority::Interactive : Priority::Background, "outbox",
+        QNetworkAccessManager::PostOperation,
+        makeRequest(QUrl(m_serverUrl + "/events/sync")), payload,
+        [this](QNetworkReply* reply) {
+            const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            const bool success = reply->error() == QNetworkReply::NoError
+                && statusCode >= 200 && statusCode < 300;
+            emit batchUploaded(success, statusCode, success ? QString() : errorMessage(reply));
+        });
 }
 
 //-==========================-
-// Отправка одиночного события
+// Одна операция очереди отправки - на свой адрес
 //-==========================-
-void NetworkSync::uploadSingleEvent(const Event& event)
+void NetworkSync::uploadChange(Change change, const QString& id, const QJsonObject& event, quint64 tag,
+    bool interactive)
 {
-    QNetworkRequest request(QUrl(m_serverUrl + "/events"));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-
-    if (!m_authToken.isEmpty()) {
-        request.setRawHeader("Authorization", "Bearer " + m_authToken.toUtf8());
+    QUrl url(m_serverUrl + "/events/" + QString::fromUtf8(QUrl::toPercentEncoding(id)));
+    QNetworkAccessManager::Operation operation = QNetworkAccessManager::PutOperation;
+    QJsonValue payload = event;
+    if (change == Change::Create) {
+        url = QUrl(m_serverUrl + "/events");
+        operation = QNetworkAccessManager::PostOperation;
+    }
+    else if (change == Change::Remove) {
+        operation = QNetworkAccessManager::DeleteOperation;
+        payload = QJsonValue();
     }
 
-    QJsonObject eventJson = event.toJson();
-    QNetworkReply* reply = m_networkManager->post(request, QJsonDocument(eventJson).toJson());
-
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        onUploadFinished(reply);
-        });
-    connect(reply, &QNetworkReply::errorOccurred, this, &NetworkSync::onErrorOccurred);
+    send(RequestKind::Change, interactive ? Priority::Interactive : Priority::Background, "event/" + id,
+        operation, makeRequest(url), payload,
+        [this, change, id, tag](QNetworkReply* reply) {
+            const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            // Событие уже удалено на сервере - цель удаления достигнута
+            const bool success = (reply->error() == QNetworkReply::NoError
+                && statusCode >= 200 && statusCode < 300)
+                || (change == Change::Remove && statusCode == 404);
+            emit changeUploaded(id, tag, success, statusCode, success ? QString() : errorMessage(reply));
+        },
+        ReplyHandler(),
+        [this, id, tag](const QString& message) { emit changeUploaded(id, tag, false, 0, message); });
 }
 
 //-==========================-
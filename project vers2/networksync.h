@@ -4,8 +4,21 @@
 #include <QObject>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QJsonValue>
 #include <QVector>
+#include <QScopedPointer>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QSharedPointer>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <functional>
 #include "event.h"
+#include "jsoneventreader.h"
+#include "cboreventreader.h"
+
+class QTimer;
 
 class NetworkSync : public QObject
 {
@@ -22,30 +35,230 @@ public:
     void downloadEvents();
     void uploadEventsAfterDownload(const QVector<Event>& localEvents);
     void uploadEvents(const QVector<Event>& events);
-    void deleteEvent(const QString& eventId);
-    void updateEvent(const Event& event);
     bool isConnected() const;
-    void uploadSingleEvent(const Event& event);
+
+    // Операции очереди отправки. Пакет (POST /events/sync) несёт только
+    // создания и правки; результат - batchUploaded. Одиночная операция идёт
+    // на свой адрес: POST /events, PUT или DELETE /events/<id>; результат -
+    // changeUploaded с тем же tag. Удаление уже удалённого (404) - успех.
+    // interactive - отправка вызвана действием пользователя и идёт впереди
+    // загрузки; иначе (хвост прошлого сеанса, повтор после ошибки) - фоном.
+    // Операция с событием заменяет ждущий запрос к тому же событию ("event/<id>").
+    enum class Change {
+        Create,
+        Update,
+        Remove
+    };
+    void uploadBatch(const QJsonArray& events, bool interactive);
+    void uploadChange(Change change, const QString& id, const QJsonObject& event, quint64 tag,
+        bool interactive);
+
+    // Курсор инкрементальной синхронизации; сброс - следующая загрузка будет полной
+    QString syncCursor() const { return m_syncCursor; }
+    void resetSyncState();
+
+    // id локальных событий на момент загрузки - для поиска дубликатов в рабочем потоке
+    void setLocalIdsProvider(std::function<QSet<QString>()> provider) { m_localIdsProvider = provider; }
+
+    // Двоичный формат обмена (application/cbor): загрузка просит его через Accept,
+    // тела запросов уходят в CBOR только после того, как сервер сам ответил в CBOR
+    bool isCborEnabled() const { return m_cborEnabled; }
+    void setCborEnabled(bool enabled);
+
+    // Счётчики трафика за сеанс: тела до и после сжатия в обе стороны
+    struct TrafficStats {
+        int requests = 0;
+        qint64 bodyBytes = 0;          // Тела запросов до сжатия
+        qint64 sentBytes = 0;          // Тела запросов, ушедшие в сеть
+        qint64 receivedBytes = 0;      // Тела ответов после распаковки
+        qint64 wireReceivedBytes = 0;  // Тела ответов по Content-Length
+    };
+    const TrafficStats& trafficStats() const { return m_traffic; }
+
+    // Сколько запросов одновременно в сети; остальные ждут в очереди по приоритету.
+    // У каждого запроса есть срок с момента постановки в очередь: истёкший
+    // в очереди не отправляется, истёкший в сети прерывается как тайм-аут.
+    int maxInFlight() const { return m_maxInFlight; }
+    void setMaxInFlight(int count);
+
+    // Подписка на изменения (SSE, /events/stream): открывается после каждой загрузки,
+    // если курсор известен (настройка sync/push), и переподключается сама.
+    // Изменения приходят через changesPushed; курсор подписки сдвигается в памяти,
+    // на диск его записывает commitSyncCursor() - после того, как получатель
+    // сохранил изменения у себя.
+    bool isPushActive() const { return m_stream != nullptr; }
+    void stopPush(); // До следующей загрузки
+    void commitSyncCursor();
 
 signals:
     void syncStarted();
     void syncFinished(bool success, const QString& message);
-    void eventsDownloaded(const QVector<Event>& events);
+    // Загрузка приходит партиями по мере приёма байтов. replaceAll - первая партия
+    // полного списка: прежние серверные события нужно отбросить. duplicateLocalIds -
+    // локальные события, которые теперь есть на сервере.
+    void eventsDownloaded(const QVector<Event>& events, const QStringList& removedIds,
+        const QStringList& duplicateLocalIds, bool replaceAll);
+    // Все партии отданы; после обработчика курсор запоминается
+    void downloadCompleted(int changed, int removed, bool fullSync);
+    // Изменения из подписки, одна партия на принятый кусок потока
+    void changesPushed(const QVector<Event>& events, const QStringList& removedIds,
+        const QStringList& duplicateLocalIds);
+    void downloadProgress(qint64 received, qint64 total);
+    void batchUploaded(bool success, int statusCode, const QString& message);
+    void changeUploaded(const QString& id, quint64 tag, bool success, int statusCode, const QString& message);
     void errorOccurred(const QString& error);
-    void singleOperationFinished(bool success, const QString& message);
 
 private slots:
-    void onUploadFinished(QNetworkReply* reply);
-    void onDownloadFinished(QNetworkReply* reply);
-    void onErrorOccurred(QNetworkReply::NetworkError code);
+    void onReplyFinished();
+    void onDownloadReadyRead();
+    void onParseFinished();
+    void startStream();
+    void onStreamReadyRead();
+    void onStreamFinished();
+    void expireRequests();
 
 private:
+    // Каждый запрос несёт свой вид и обработчик завершения: ответ разбирается
+    // ровно один раз и только тем, кто его ждёт
+    enum class RequestKind {
+        Download,
+        Upload,
+        Batch,
+        Change
+    };
+    typedef std::function<void(QNetworkReply*)> ReplyHandler;
+    typedef std::function<void(const QString&)> FailHandler;
+
+    // Правка пользователя не ждёт загрузку, загрузка не ждёт фоновую очередь
+    enum class Priority {
+        Interactive,
+        Sync,
+        Background
+    };
+    static const int kPriorityCount = 3;
+
+    // Запрос хранится целиком: он ждёт в очереди, а на 415 его можно повторить в JSON.
+    // key - цель запроса: новый запрос заменяет ждущий с тем же ключом и не уходит,
+    // пока прежний в полёте, чтобы правки одного события не обгоняли друг друга.
+    struct PendingRequest {
+        RequestKind kind;
+        Priority priority;
+        QString key;
+        ReplyHandler handler;
+        ReplyHandler started; // Ответ создан - загрузка подключает приём данных
+        FailHandler failed;   // Запрос не ушёл (срок истёк в очереди); без него - по виду
+        QNetworkAccessManager::Operation operation;
+        QNetworkRequest request;
+        QJsonValue payload;
+        bool cbor = false;
+        bool compressed = false;
+        qint64 bodyBytes = 0;
+        qint64 sentBytes = 0;
+        qint64 deadline = 0; // По m_clock; отсчёт с постановки в очередь
+    };
+
+    // Разбор идёт в пуле потоков; разборщиком владеют загрузка и задача разбора.
+    // Формат выбирается по Content-Type ответа до первого куска данных.
+    struct DownloadParser {
+        JsonEventReader reader;
+        CborEventReader cborReader;
+        bool cbor = false;
+        QSet<QString> localIds;
+    };
+    struct ParseResult {
+        QVector<Event> events;
+        QStringList removedIds;
+        QStringList duplicateLocalIds;
+        bool failed = false;
+        QString error;
+        bool atEnd = false;
+    };
+
+    // Состояние текущей загрузки: разбор идёт по мере прихода данных
+    struct Download {
+        ~Download()
+        {
+            // Результат недоделанного разбора никому не нужен
+            if (watcher) {
+                watcher->disconnect();
+                watcher->deleteLater();
+            }
+        }
+
+        QNetworkReply* reply = nullptr;
+        QSharedPointer<DownloadParser> parser;
+        QFutureWatcher<ParseResult>* watcher = nullptr;
+        QByteArray received;
+        QVector<Event> events;
+        QStringList removedIds;
+        QStringList duplicateLocalIds;
+        QString cursor;
+        QByteArray etag;
+        int generation = 0;
+        bool delta = false;
+        bool headersRead = false;
+        bool fullSync = false;
+        bool replacePending = false;
+        bool transferDone = false;
+        bool parsing = false;
+        qint64 receivedBytes = 0;
+        int changed = 0;
+        int removed = 0;
+    };
+
     QNetworkAccessManager* m_networkManager;
     QString m_serverUrl;
     QString m_authToken;
+    QString m_syncCursor;
+    QByteArray m_etag;
+    int m_stateGeneration;
+    QScopedPointer<Download> m_download;
+    QHash<QNetworkReply*, PendingRequest> m_pending; // В полёте
+    QList<PendingRequest> m_queue[kPriorityCount];   // Ждут своей очереди
+    int m_maxInFlight;
+    QElapsedTimer m_clock;
+    QTimer* m_deadlineTimer; // Ближайший срок среди ждущих и летящих запросов
+    std::function<QSet<QString>()> m_localIdsProvider;
+    bool m_cborEnabled;
+    bool m_serverCbor; // Сервер уже ответил в CBOR - ему можно так же и писать
+    bool m_compressBodies; // Сервер не отказывался от Content-Encoding: deflate
+    TrafficStats m_traffic;
+    bool m_pushEnabled;
+    QNetworkReply* m_stream;       // Долгий запрос подписки, мимо очереди
+    QByteArray m_streamBuffer;     // Недочитанное сообщение SSE
+    QTimer* m_streamTimer;         // Переподключение
+    int m_streamAttempt;
+    int m_streamRetryMs;           // Базовая задержка; сервер может задать её полем retry
 
+    QNetworkRequest makeRequest(const QUrl& url) const;
+    // Запрос встаёт в очередь; payload кодируется при отправке: CBOR или JSON,
+    // пустое значение - запрос без тела
+    void send(RequestKind kind, Priority priority, const QString& key,
+        QNetworkAccessManager::Operation operation, const QNetworkRequest& request,
+        const QJsonValue& payload, const ReplyHandler& handler, const ReplyHandler& started = ReplyHandler(),
+        const FailHandler& failed = FailHandler());
+    void dispatchQueued();
+    bool start(PendingRequest pending);
+    bool isKeyInFlight(const QString& key) const;
+    void cancelQueued(const QString& key);
+    void armDeadlineTimer();
+    void failQueued(const PendingRequest& pending, const QString& message);
+    void recordTraffic(const PendingRequest& pending, QNetworkReply* reply);
+    void handleUploadReply(QNetworkReply* reply);
+    void attachDownload(QNetworkReply* reply);
+    void handleDownloadReply(QNetworkReply* reply);
+    QString errorMessage(QNetworkReply* reply) const;
+    void saveSyncState();
+    void abortDownload();
+    void startParse();
+    static ParseResult parseChunk(QSharedPointer<DownloadParser> parser, const QByteArray& data, bool atEnd);
+    template <class Reader>
+    static void readEvents(Reader& reader, const QSet<QString>& localIds, bool atEnd, ParseResult& result);
+    bool flushDownloadBatch();
+    void completeDownload();
+    void endDownload(bool success, const QString& message);
+    int streamReconnectDelay() const;
     QJsonArray eventsToJsonArray(const QVector<Event>& events);
-    QVector<Event> jsonArrayToEvents(const QJsonArray& jsonArray);
 };
 
 #endif // NETWORKSYNC_H
\ No newline at end of file
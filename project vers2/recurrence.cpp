@@ -0,0 +1,151 @@
+#include "recurrence.h"
+#include <QStringList>
+
+namespace {
+    const int kMaxOccurrences = 10000; // Защита от бесконечной развёртки
+    const char* const kDateFormat = "yyyyMMdd";
+    const qint64 kMsPerDay = 24 * 60 * 60 * 1000LL;
+}
+
+Recurrence::Recurrence(Frequency frequency, int interval)
+    : m_frequency(frequency)
+    , m_interval(qMax(1, interval))
+    , m_count(0)
+{
+}
+
+void Recurrence::setFrequency(Frequency frequency) { m_frequency = frequency; }
+void Recurrence::setInterval(int interval) { m_interval = qMax(1, interval); }
+void Recurrence::setCount(int count) { m_count = qMax(0, count); }
+void Recurrence::setUntil(const QDate& until) { m_until = until; }
+
+void Recurrence::addException(const QDate& date)
+{
+    if (date.isValid() && !m_exceptions.contains(date)) {
+        m_exceptions.append(date);
+    }
+}
+
+QDateTime Recurrence::occurrenceAt(const QDateTime& first, int index) const
+{
+    switch (m_frequency) {
+    case Daily:
+        return first.addDays(qint64(index) * m_interval);
+    case Weekly:
+        return first.addDays(qint64(index) * 7 * m_interval);
+    case Monthly:
+        return first.addMonths(index * m_interval);
+    default:
+        return index == 0 ? first : QDateTime();
+    }
+}
+
+//-==========================-
+// Начала вхождений, пересекающих окно [from, to)
+//-==========================-
+QVector<QDateTime> Recurrence::occurrences(const QDateTime& first, qint64 durationMs,
+    const QDateTime& from, const QDateTime& to) const
+{
+    QVector<QDateTime> result;
+    if (!first.isValid() || !isRecurring() || from >= to) return result;
+
+    const qint64 length = qMax<qint64>(durationMs, 1);
+
+    // Сразу перескакиваем к первому вхождению, которое может попасть в окно
+    int index = 0;
+    const qint64 lagDays = first.date().daysTo(from.date()) - length / kMsPerDay - 1;
+    if (lagDays > 0) {
+        switch (m_frequency) {
+        case Daily:
+            index = int(lagDays / m_interval);
+            break;
+        case Weekly:
+            index = int(lagDays / (7 * m_interval));
+            break;
+        case Monthly:
+            index = int(lagDays / 31 / m_interval);
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (int produced = 0; produced < kMaxOccurrences; ++index) {
+        if (m_count > 0 && index >= m_count) break;
+
+        QDateTime start = occurrenceAt(first, index);
+        if (!start.isValid() || start >= to) break;
+        if (m_until.isValid() && start.date() > m_until) break;
+        if (start.addMSecs(length) <= from) continue;
+        if (m_exceptions.contains(start.date())) continue;
+
+        result.append(start);
+        ++produced;
+    }
+    return result;
+}
+
+QString Recurrence::toRule() const
+{
+    if (!isRecurring()) return QString();
+
+    static const char* const names[] = { "", "DAILY", "WEEKLY", "MONTHLY" };
+    QStringList parts;
+    parts << "FREQ=" + QString::fromLatin1(names[m_frequency]);
+    if (m_interval > 1) {
+        parts << QString("INTERVAL=%1").arg(m_interval);
+    }
+    if (m_count > 0) {
+        parts << QString("COUNT=%1").arg(m_count);
+    }
+    if (m_until.isValid()) {
+        parts << "UNTIL=" + m_until.toString(kDateFormat);
+    }
+    if (!m_exceptions.isEmpty()) {
+        QStringList dates;
+        for (const QDate& date : m_exceptions) {
+            dates << date.toString(kDateFormat);
+        }
+        parts << "EXDATE=" + dates.join(',');
+    }
+    return parts.join(';');
+}
+
+Recurrence Recurrence::fromRule(const QString& rule)
+{
+    Recurrence recurrence;
+    const QStringList parts = rule.split(';', Qt::SkipEmptyParts);
+    for (const QString& part : parts) {
+        const QString key = part.section('=', 0, 0).trimmed().toUpper();
+        const QString value = part.section('=', 1).trimmed();
+
+        if (key == "FREQ") {
+            const QString freq = value.toUpper();
+            if (freq == "DAILY") recurrence.setFrequency(Daily);
+            else if (freq == "WEEKLY") recurrence.setFrequency(Weekly);
+            else if (freq == "MONTHLY") recurrence.setFrequency(Monthly);
+        }
+        else if (key == "INTERVAL") {
+            recurrence.setInterval(value.toInt());
+        }
+        else if (key == "COUNT") {
+            recurrence.setCount(value.toInt());
+        }
+        else if (key == "UNTIL") {
+            recurrence.setUntil(QDate::fromString(value.left(8), kDateFormat));
+        }
+        else if (key == "EXDATE") {
+            for (const QString& date : value.split(',', Qt::SkipEmptyParts)) {
+                recurrence.addException(QDate::fromString(date.left(8), kDateFormat));
+            }
+        }
+    }
+    return recurrence;
+}
+
+bool Recurrence::operator==(const Recurrence& other) const
+{
+    return m_frequency == other.m_frequency && m_interval == other.m_interval
+        && m_count == other.m_count && m_until == other.m_until
+        && m_exceptions == other.m_exceptions;
+}
@@ -0,0 +1,55 @@
+#ifndef RECURRENCE_H
+#define RECURRENCE_H
+
+#include <QString>
+#include <QDate>
+#include <QDateTime>
+#include <QVector>
+
+// Правило повторения в духе RRULE: FREQ=WEEKLY;INTERVAL=1;COUNT=10;UNTIL=20250901;EXDATE=...
+// Хранится один раз в событии, вхождения разворачиваются только для нужного окна.
+class Recurrence
+{
+public:
+    enum Frequency {
+        None,
+        Daily,
+        Weekly,
+        Monthly
+    };
+
+    Recurrence(Frequency frequency = None, int interval = 1);
+
+    Frequency frequency() const { return m_frequency; }
+    int interval() const { return m_interval; }
+    int count() const { return m_count; }
+    QDate until() const { return m_until; }
+    QVector<QDate> exceptions() const { return m_exceptions; }
+    bool isRecurring() const { return m_frequency != None; }
+
+    void setFrequency(Frequency frequency);
+    void setInterval(int interval);
+    void setCount(int count);
+    void setUntil(const QDate& until);
+    void addException(const QDate& date);
+
+    QVector<QDateTime> occurrences(const QDateTime& first, qint64 durationMs,
+        const QDateTime& from, const QDateTime& to) const;
+
+    QString toRule() const;
+    static Recurrence fromRule(const QString& rule);
+
+    bool operator==(const Recurrence& other) const;
+    bool operator!=(const Recurrence& other) const { return !(*this == other); }
+
+private:
+    Frequency m_frequency;
+    int m_interval;
+    int m_count;
+    QDate m_until;
+    QVector<QDate> m_exceptions;
+
+    QDateTime occurrenceAt(const QDateTime& first, int index) const;
+};
+
+#endif // RECURRENCE_H
@@ -0,0 +1,497 @@
+#include "syncoutbox.h"
+#include "networksync.h"
+#include <QTimer>
+#include <QFile>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QRandomGenerator>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+    const int kBatchSize = 100;
+    // Правки, сделанные подряд, уходят одним пакетом
+    const int kCoalesceDelayMs = 500;
+    const int kBackoffBaseMs = 2000;
+    const int kBackoffMaxMs = 5 * 60 * 1000;
+    // Правки подряд переписывают файл очереди один раз
+    const int kSaveDelayMs = 1000;
+
+    // Отказ по содержимому: повтор того же запроса не поможет
+    bool isRejected(int statusCode)
+    {
+        return statusCode >= 400 && statusCode < 500 && statusCode != 408 && statusCode != 429;
+    }
+}
+
+SyncOutbox::SyncOutbox(const QString& path, NetworkSync* sync, QObject* parent)
+    : QObject(parent)
+    , m_path(path)
+    , m_sync(sync)
+    , m_nextSequence(1)
+    , m_timer(new QTimer(this))
+    , m_saveTimer(new QTimer(this))
+    , m_attempt(0)
+    , m_batchLimit(kBatchSize)
+    , m_batchSupported(true)
+    , m_paused(false)
+    , m_interactive(false)
+    , m_roundSent(0)
+{
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &SyncOutbox::sendBatch);
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(kSaveDelayMs);
+    connect(m_saveTimer, &QTimer::timeout, this, &SyncOutbox::startWrite);
+    connect(m_sync, &NetworkSync::batchUploaded, this, &SyncOutbox::onBatchUploaded);
+    connect(m_sync, &NetworkSync::changeUploaded, this, &SyncOutbox::onChangeUploaded);
+
+    // Хвост прошлого сеанса отправляется при первой возможности
+    load();
+    if (!m_operations.isEmpty()) {
+        schedule(kCoalesceDelayMs);
+    }
+}
+
+SyncOutbox::~SyncOutbox()
+{
+    // Отложенная запись не должна потеряться при выходе
+    m_saveFuture.waitForFinished();
+    if (m_saveTimer->isActive()) {
+        writeFile(m_path, serialize());
+    }
+}
+
+void SyncOutbox::enqueueCreate(const Event& event)
+{
+    Operation operation;
+    operation.create = true;
+    operation.source = event.source();
+    operation.json = event.toJson();
+    enqueue(event.id(), operation);
+}
+
+void SyncOutbox::enqueueUpsert(const Event& event)
+{
+    Operation operation;
+    operation.source = event.source();
+    operation.json = event.toJson();
+    enqueue(event.id(), operation);
+}
+
+void SyncOutbox::enqueueRemove(const QString& id, Event::Source source)
+{
+    Operation operation;
+    operation.remove = true;
+    operation.source = source;
+    enqueue(id, operation);
+}
+
+//-==========================-
+// Слияние по id: последняя операция заменяет предыдущие
+//-==========================-
+void SyncOutbox::enqueue(const QString& id, const Operation& operation)
+{
+    Operation& stored = m_operations[id];
+    // Правка события, создание которого ещё не подтверждено, остаётся созданием
+    const bool create = operation.create || (stored.create && !operation.remove);
+    stored = operation;
+    stored.create = create;
+    stored.sequence = m_nextSequence++;
+    m_interactive = true;
+    save();
+
+    // Во время отсрочки после ошибки раньше срока не отправляем
+    if (m_attempt == 0) {
+        schedule(kCoalesceDelayMs);
+    }
+}
+
+QVector<Event> SyncOutbox::pendingEvents() const
+{
+    QVector<Event> events;
+    for (auto it = m_operations.constBegin(); it != m_operations.constEnd(); ++it) {
+        if (!it->remove) {
+            Event event = Event::fromJson(it->json);
+            event.setSource(it->source);
+            events.append(event);
+        }
+    }
+    return events;
+}
+
+QStringList SyncOutbox::pendingRemovals(Event::Source source) const
+{
+    QStringList ids;
+    for (auto it = m_operations.constBegin(); it != m_operations.constEnd(); ++it) {
+        if (it->remove && it->source == source) {
+            ids.append(it.key());
+        }
+    }
+    return ids;
+}
+
+QVector<Event> SyncOutbox::pendingEvents(const QStringList& ids) const
+{
+    QVector<Event> events;
+    for (const QString& id : ids) {
+        auto it = m_operations.constFind(id);
+        if (it != m_operations.constEnd() && !it->remove) {
+            Event event = Event::fromJson(it->json);
+            event.setSource(it->source);
+            events.append(event);
+        }
+    }
+    return events;
+}
+
+QStringList SyncOutbox::pendingRemovals(Event::Source source, const QStringList& ids) const
+{
+    QStringList removals;
+    for (const QString& id : ids) {
+        auto it = m_operations.constFind(id);
+        if (it != m_operations.constEnd() && it->remove && it->source == source) {
+            removals.append(id);
+        }
+    }
+    return removals;
+}
+
+void SyncOutbox::setPaused(bool paused)
+{
+    m_paused = paused;
+    if (paused) {
+        m_timer->stop();
+    }
+}
+
+void SyncOutbox::flush()
+{
+    m_paused = false;
+    m_attempt = 0;
+    m_batchSupported = true; // Токен или сервер могли смениться - пробуем пакет снова
+    m_interactive = true;
+    schedule(0);
+}
+
+void SyncOutbox::schedule(int delayMs)
+{
+    if (m_paused) return;
+    m_timer->start(delayMs);
+}
+
+//-==========================-
+// Круг отправки: пакет правок и одиночные удаления (в полёте не больше одного круга)
+//-==========================-
+void SyncOutbox::sendBatch()
+{
+    if (m_paused || !m_inFlight.isEmpty() || m_operations.isEmpty() || !m_sync->isConnected()) {
+        return;
+    }
+
+    // Старые изменения уходят первыми
+    QVector<QPair<quint64, QString>> order;
+    order.reserve(m_operations.size());
+    for (auto it = m_operations.constBegin(); it != m_operations.constEnd(); ++it) {
+        order.append(qMakePair(it->sequence, it.key()));
+    }
+    std::sort(order.begin(), order.end());
+    if (order.size() > m_batchLimit) {
+        order.resize(m_batchLimit);
+    }
+
+    m_roundSent = 0;
+    m_roundError.clear();
+    m_authError.clear();
+
+    QJsonArray events;
+    QStringList changes;
+    for (const auto& entry : order) {
+        const Operation& operation = m_operations[entry.second];
+        if (!operation.remove && m_batchSupported) {
+            events.append(operation.json);
+            m_batchIds.append(entry.second);
+        }
+        else {
+            changes.append(entry.second);
+        }
+        m_inFlight.insert(entry.second, entry.first);
+    }
+
+    if (!events.isEmpty()) {
+        m_sync->uploadBatch(events, m_interactive);
+    }
+    for (const QString& id : changes) {
+        sendChange(id);
+    }
+}
+
+void SyncOutbox::sendChange(const QString& id)
+{
+    const Operation& operation = m_operations[id];
+    const NetworkSync::Change change = operation.remove ? NetworkSync::Change::Remove
+        : operation.create ? NetworkSync::Change::Create : NetworkSync::Change::Update;
+    m_sync->uploadChange(change, id, operation.json, operation.sequence, m_interactive);
+}
+
+void SyncOutbox::onBatchUploaded(bool success, int statusCode, const QString& message)
+{
+    if (m_batchIds.isEmpty()) return;
+    const QStringList ids = m_batchIds;
+    m_batchIds.clear();
+
+    if (success) {
+        for (const QString& id : ids) {
+            complete(id);
+        }
+        m_batchLimit = qMin(m_batchLimit * 2, kBatchSize);
+    }
+    else if (statusCode == 403 || statusCode == 404 || statusCode == 405 || statusCode == 501) {
+        // Пакетного адреса нет или он не разрешён токену - это не отказ в самих
+        // изменениях: следующий круг уйдёт по одной операции
+        qDebug() << "Пакетная отправка недоступна: HTTP" << statusCode;
+        m_batchSupported = false;
+        for (const QString& id : ids) {
+            m_inFlight.remove(id);
+        }
+    }
+    else if (statusCode != 401 && isRejected(statusCode)) {
+        // Сервер отклонил содержимое пакета: делим его, пока виновная операция
+        // не останется одна, и убираем её из очереди
+        if (ids.size() > 1) {
+            m_batchLimit = ids.size() / 2;
+            for (const QString& id : ids) {
+                m_inFlight.remove(id);
+            }
+        }
+        else {
+            reject(ids.first(), statusCode, message);
+            m_batchLimit = kBatchSize;
+        }
+    }
+    else {
+        for (const QString& id : ids) {
+            m_inFlight.remove(id);
+        }
+        if (statusCode == 401) {
+            m_authError = message;
+        }
+        else {
+            m_roundError = message;
+        }
+    }
+    finishRound();
+}
+
+void SyncOutbox::onChangeUploaded(const QString& id, quint64 tag, bool success, int statusCode,
+    const QString& message)
+{
+    // Ответ на запрос прежнего круга
+    auto it = m_inFlight.constFind(id);
+    if (it == m_inFlight.constEnd() || it.value() != tag) return;
+
+    if (success) {
+        complete(id);
+    }
+    else if (statusCode == 401) {
+        m_inFlight.remove(id);
+        m_authError = message;
+    }
+    else if (isRejected(statusCode)) {
+        // Здесь и 403: токену не разрешена именно эта операция
+        reject(id, statusCode, message);
+    }
+    else {
+        m_inFlight.remove(id);
+        m_roundError = message;
+    }
+    finishRound();
+}
+
+// Операция дошла: снимаем её, если событие не менялось после отправки
+void SyncOutbox::complete(const QString& id)
+{
+    const quint64 sequence = m_inFlight.take(id);
+    auto operation = m_operations.find(id);
+    if (operation != m_operations.end()) {
+        if (operation->sequence == sequence) {
+            m_operations.erase(operation);
+        }
+        else {
+            operation->create = false; // Событие на сервере уже есть - новая версия правка
+        }
+    }
+    ++m_roundSent;
+}
+
+// Если событие успели изменить снова, новая версия получает свой шанс
+void SyncOutbox::reject(const QString& id, int statusCode, const QString& message)
+{
+    const quint64 sequence = m_inFlight.take(id);
+    auto operation = m_operations.constFind(id);
+    if (operation != m_operations.constEnd() && operation->sequence == sequence) {
+        quarantine(id, statusCode, message);
+    }
+}
+
+//-==========================-
+// Итог круга: все запросы ответили
+//-==========================-
+void SyncOutbox::finishRound()
+{
+    if (!m_inFlight.isEmpty()) return;
+    save();
+
+    // Отказ в доступе повтором не исправить - ждём явной синхронизации
+    if (!m_authError.isEmpty()) {
+        m_paused = true;
+        m_timer->stop();
+        emit flushFailed(m_authError, false);
+        return;
+    }
+    if (!m_roundError.isEmpty()) {
+        // Повтор после ошибки никого не ждёт - он уходит фоном
+        m_interactive = false;
+        ++m_attempt;
+        schedule(backoffDelay());
+        emit flushFailed(m_roundError, true);
+        return;
+    }
+
+    m_attempt = 0;
+    if (m_roundSent > 0) {
+        emit flushed(m_roundSent);
+    }
+    if (!m_operations.isEmpty()) {
+        schedule(0);
+    }
+}
+
+//-==========================-
+// Экспоненциальная задержка с разбросом: половина фиксирована, половина случайна
+//-==========================-
+int SyncOutbox::backoffDelay() const
+{
+    const int shift = qMin(m_attempt - 1, 16);
+    const int delay = int(qMin<qint64>(qint64(kBackoffBaseMs) << shift, kBackoffMaxMs));
+    return delay / 2 + int(QRandomGenerator::global()->bounded(delay / 2 + 1));
+}
+
+//-==========================-
+// Отклонённая операция уходит из очереди в файл карантина для разбора
+//-==========================-
+void SyncOutbox::quarantine(const QString& id, int statusCode, const QString& message)
+{
+    const Operation operation = m_operations.take(id);
+    save();
+
+    const QString path = m_path + ".rejected";
+    QJsonArray rejected;
+    QFile existing(path);
+    if (existing.open(QIODevice::ReadOnly)) {
+        rejected = QJsonDocument::fromJson(existing.readAll()).array();
+        existing.close();
+    }
+
+    QJsonObject object;
+    object["id"] = id;
+    object["op"] = operation.remove ? "remove" : operation.create ? "create" : "upsert";
+    object["source"] = int(operation.source);
+    if (!operation.remove) {
+        object["event"] = operation.json;
+    }
+    object["status"] = statusCode;
+    object["message"] = message;
+    rejected.append(object);
+
+    QSaveFile file(path);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(rejected).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+    else {
+        qDebug() << "Не удалось сохранить отклонённую операцию:" << file.errorString();
+    }
+
+    emit operationRejected(id, message);
+}
+
+//-==========================-
+// Хранение очереди между запусками
+//-==========================-
+void SyncOutbox::load()
+{
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    const QJsonArray operations = QJsonDocument::fromJson(file.readAll()).array();
+    for (const QJsonValue& value : operations) {
+        const QJsonObject object = value.toObject();
+        const QString id = object.value("id").toString();
+        if (id.isEmpty()) continue;
+
+        Operation operation;
+        operation.remove = object.value("op").toString() == "remove";
+        operation.create = object.value("op").toString() == "create";
+        operation.source = static_cast<Event::Source>(object.value("source").toInt(Event::Server));
+        operation.json = object.value("event").toObject();
+        operation.sequence = m_nextSequence++;
+        m_operations.insert(id, operation);
+    }
+}
+
+// Запись откладывается: правки подряд склеиваются в одну
+void SyncOutbox::save()
+{
+    if (!m_saveTimer->isActive()) {
+        m_saveTimer->start();
+    }
+}
+
+void SyncOutbox::startWrite()
+{
+    // Прежняя запись ещё идёт - эта подождёт, чтобы старый файл не лёг поверх нового
+    if (m_saveFuture.isRunning()) {
+        m_saveTimer->start();
+        return;
+    }
+    m_saveFuture = QtConcurrent::run(&SyncOutbox::writeFile, m_path, serialize());
+}
+
+QByteArray SyncOutbox::serialize() const
+{
+    // Файл пишется в порядке очереди - порядок восстанавливается при загрузке
+    QVector<QPair<quint64, QString>> order;
+    for (auto it = m_operations.constBegin(); it != m_operations.constEnd(); ++it) {
+        order.append(qMakePair(it->sequence, it.key()));
+    }
+    std::sort(order.begin(), order.end());
+
+    QJsonArray operations;
+    for (const auto& entry : order) {
+        const Operation& operation = m_operations[entry.second];
+        QJsonObject object;
+        object["id"] = entry.second;
+        object["op"] = operation.remove ? "remove" : operation.create ? "create" : "upsert";
+        object["source"] = int(operation.source);
+        if (!operation.remove) {
+            object["event"] = operation.json;
+        }
+        operations.append(object);
+    }
+    return QJsonDocument(operations).toJson(QJsonDocument::Compact);
+}
+
+// Выполняется в рабочем потоке: получает готовые байты и больше ничего не трогает
+void SyncOutbox::writeFile(const QString& path, const QByteArray& data)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Не удалось сохранить очередь отправки:" << file.errorString();
+        return;
+    }
+    file.write(data);
+    file.commit();
+}
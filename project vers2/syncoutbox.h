@@ -0,0 +1,105 @@
+#ifndef SYNCOUTBOX_H
+#define SYNCOUTBOX_H
+
+#include <QObject>
+#include <QFuture>
+#include <QHash>
+#include <QJsonObject>
+#include <QStringList>
+#include <QVector>
+#include "event.h"
+
+class QTimer;
+class NetworkSync;
+
+// Очередь изменений для сервера, переживающая перезапуск (JSON-файл).
+// На каждый id хранится только последняя операция - несколько правок одного
+// события уходят одной. Создания и правки отправляются пакетом в /events/sync,
+// удаления - каждое на свой DELETE /events/<id>. Если сервер не знает пакетного
+// адреса или не даёт его токену (403/404/405/501), очередь до следующей явной
+// синхронизации отправляет всё по одной операции: POST /events, PUT /events/<id>.
+// При сетевых ошибках и 5xx - повтор с экспоненциальной задержкой и случайным
+// разбросом, при 401 - пауза до явной синхронизации. Прочие 4xx относятся
+// к содержимому: пакет делится пополам, пока отклонённая операция не останется
+// одна; она переносится в карантин (<path>.rejected) и не задерживает
+// остальную очередь. Файл очереди переписывается не на каждую правку, а
+// с отсрочкой, и пишется в пуле потоков; деструктор дописывает последнее.
+class SyncOutbox : public QObject
+{
+    Q_OBJECT
+
+public:
+    SyncOutbox(const QString& path, NetworkSync* sync, QObject* parent = nullptr);
+    ~SyncOutbox();
+
+    void enqueueCreate(const Event& event);
+    void enqueueUpsert(const Event& event);
+    void enqueueRemove(const QString& id, Event::Source source);
+
+    bool isEmpty() const { return m_operations.isEmpty(); }
+    int size() const { return m_operations.size(); }
+    // Ещё не подтверждённые сервером изменения - накладываются поверх загрузки
+    QVector<Event> pendingEvents() const;
+    QStringList pendingRemovals(Event::Source source) const;
+    // То же только для указанных id - после точечного обновления с сервера
+    QVector<Event> pendingEvents(const QStringList& ids) const;
+    QStringList pendingRemovals(Event::Source source, const QStringList& ids) const;
+
+    bool isPaused() const { return m_paused; }
+    void setPaused(bool paused);
+    void flush(); // Отправить сейчас, не дожидаясь отсрочки
+
+signals:
+    void flushed(int sent);
+    void flushFailed(const QString& message, bool willRetry);
+    void operationRejected(const QString& id, const QString& message);
+
+private slots:
+    void sendBatch();
+    void onBatchUploaded(bool success, int statusCode, const QString& message);
+    void onChangeUploaded(const QString& id, quint64 tag, bool success, int statusCode, const QString& message);
+    void startWrite();
+
+private:
+    struct Operation {
+        bool remove = false;
+        bool create = false; // Сервер события ещё не видел: POST вместо PUT
+        Event::Source source = Event::Server;
+        QJsonObject json; // Событие для upsert
+        quint64 sequence = 0;
+    };
+
+    QString m_path;
+    NetworkSync* m_sync;
+    QHash<QString, Operation> m_operations;
+    QHash<QString, quint64> m_inFlight; // id -> номер отправленной версии
+    QStringList m_batchIds;             // Часть m_inFlight, ушедшая пакетом
+    quint64 m_nextSequence;
+    QTimer* m_timer;
+    QTimer* m_saveTimer;
+    QFuture<void> m_saveFuture; // Запись файла в пуле потоков
+    int m_attempt;
+    int m_batchLimit; // Уменьшается при делении отклонённого пакета
+    bool m_batchSupported;
+    bool m_paused;
+    bool m_interactive; // Отправку вызвал пользователь - запросы идут впереди загрузки
+    // Итог текущего круга отправки - подводится, когда ответили все его запросы
+    int m_roundSent;
+    QString m_roundError; // Сбой сети или сервера - повтор с задержкой
+    QString m_authError;  // 401 - пауза
+
+    void enqueue(const QString& id, const Operation& operation);
+    void schedule(int delayMs);
+    void sendChange(const QString& id);
+    void complete(const QString& id);
+    void reject(const QString& id, int statusCode, const QString& message);
+    void finishRound();
+    int backoffDelay() const;
+    void quarantine(const QString& id, int statusCode, const QString& message);
+    void load();
+    void save();
+    QByteArray serialize() const;
+    static void writeFile(const QString& path, const QByteArray& data);
+};
+
+#endif // SYNCOUTBOX_H
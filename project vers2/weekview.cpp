@@ -0,0 +1,270 @@
+#include "weekview.h"
+#include "eventstore.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QScrollBar>
+#include <QMouseEvent>
+#include <QLocale>
+#include <algorithm>
+
+namespace {
+    const int kHourHeight = 44;
+    const int kHeaderHeight = 28;
+    const int kTimeColumnWidth = 48;
+    const int kMinBlockHeight = 16;
+    const int kWeeksAround = 52;        // Прокрутка на год в каждую сторону
+    const int kMinutesPerDay = 24 * 60;
+}
+
+WeekView::WeekView(QWidget* parent)
+    : QAbstractScrollArea(parent)
+    , m_store(nullptr)
+    , m_source(Event::Local)
+    , m_anchor(QDate::currentDate())
+    , m_dirty(true)
+{
+    horizontalScrollBar()->setRange(-kWeeksAround, kWeeksAround);
+    horizontalScrollBar()->setSingleStep(1);
+    horizontalScrollBar()->setPageStep(4);
+    horizontalScrollBar()->setValue(0);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+    verticalScrollBar()->setSingleStep(kHourHeight / 2);
+    updateScrollBars();
+    verticalScrollBar()->setValue(8 * kHourHeight); // Рабочий день в начале окна
+}
+
+void WeekView::setEventStore(const EventStore* store)
+{
+    m_store = store;
+    invalidate();
+}
+
+bool WeekView::setEventSource(Event::Source source)
+{
+    if (m_source == source) return false;
+    m_source = source;
+    return true;
+}
+
+// Неделя с указанной датой становится опорной (значение прокрутки 0)
+void WeekView::setAnchorDate(const QDate& date)
+{
+    if (!date.isValid()) return;
+    m_anchor = date;
+    horizontalScrollBar()->setValue(0);
+    m_layoutWeek = QDate();
+    viewport()->update();
+}
+
+QDate WeekView::weekStart() const
+{
+    QDate date = m_anchor.addDays(7 * horizontalScrollBar()->value());
+    return date.addDays(1 - date.dayOfWeek());
+}
+
+void WeekView::invalidate()
+{
+    m_dirty = true;
+    viewport()->update();
+}
+
+// Перестраиваемся, только если изменение задело показанную неделю
+void WeekView::invalidateDays(const QDate& from, const QDate& to)
+{
+    const QDate week = weekStart();
+    if ((!to.isValid() || to >= week) && (!from.isValid() || from < week.addDays(7))) {
+        invalidate();
+    }
+}
+
+QRect WeekView::contentRect() const
+{
+    return viewport()->rect().adjusted(kTimeColumnWidth, kHeaderHeight, 0, 0);
+}
+
+void WeekView::updateScrollBars()
+{
+    const int visible = qMax(0, viewport()->height() - kHeaderHeight);
+    verticalScrollBar()->setPageStep(visible);
+    verticalScrollBar()->setRange(0, qMax(0, 24 * kHourHeight - visible));
+}
+
+void WeekView::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void WeekView::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+    viewport()->update();
+}
+
+//-==========================-
+// Раскладка недели: один запрос диапазона, события режутся по дням
+//-==========================-
+void WeekView::ensureLayout() const
+{
+    const QDate week = weekStart();
+    if (!m_dirty && m_layoutWeek == week) return;
+
+    m_dirty = false;
+    m_layoutWeek = week;
+    m_blocks.clear();
+    if (!m_store) return;
+
+    const QDateTime from = week.startOfDay();
+    const QDateTime to = week.addDays(7).startOfDay();
+    for (const Event& event : m_store->eventsInRange(from, to, m_source)) {
+        // Событие без длительности рисуется получасовым блоком
+        const QDateTime start = event.start();
+        const QDateTime end = event.end() > start ? event.end() : start.addSecs(30 * 60);
+        const QString time = start.time().toString("hh:mm");
+
+        const int firstDay = int(qMax<qint64>(0, week.daysTo(start.date())));
+        const int lastDay = int(qMin<qint64>(6, week.daysTo(end.addMSecs(-1).date())));
+        for (int day = firstDay; day <= lastDay; ++day) {
+            const QDateTime dayStart = week.addDays(day).startOfDay();
+            const int startMinute = start > dayStart ? int(dayStart.secsTo(start) / 60) : 0;
+            const int endMinute = int(qMin<qint64>(kMinutesPerDay, dayStart.secsTo(end) / 60));
+            m_blocks.append({ day, startMinute, qMax(endMinute, startMinute + 1), 0, 1,
+                event.color().rgba(), event.title(), time });
+        }
+    }
+    assignLanes(m_blocks);
+}
+
+// Пересекающиеся блоки одного дня делят колонку на дорожки
+void WeekView::assignLanes(QVector<Block>& blocks) const
+{
+    std::sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) {
+        if (a.day != b.day) return a.day < b.day;
+        return a.startMinute < b.startMinute;
+        });
+
+    QVector<int> laneEnds;
+    int begin = 0;
+    while (begin < blocks.size()) {
+        // Группа - цепочка блоков дня, перекрывающихся друг с другом
+        int end = begin;
+        int groupEnd = blocks[begin].endMinute;
+        laneEnds.clear();
+        while (end < blocks.size() && blocks[end].day == blocks[begin].day
+            && (end == begin || blocks[end].startMinute < groupEnd)) {
+            Block& block = blocks[end];
+            int lane = 0;
+            while (lane < laneEnds.size() && laneEnds[lane] > block.startMinute) {
+                ++lane;
+            }
+            if (lane == laneEnds.size()) {
+                laneEnds.append(block.endMinute);
+            }
+            else {
+                laneEnds[lane] = block.endMinute;
+            }
+            block.lane = lane;
+            groupEnd = qMax(groupEnd, block.endMinute);
+            ++end;
+        }
+        for (int i = begin; i < end; ++i) {
+            blocks[i].lanes = laneEnds.size();
+        }
+        begin = end;
+    }
+}
+
+//-==========================-
+// Отрисовка только видимой полосы часов
+//-==========================-
+void WeekView::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
+    ensureLayout();
+
+    QPainter p(viewport());
+    const QPalette& pal = palette();
+    const QRect content = contentRect();
+    const int scrollY = verticalScrollBar()->value();
+    const qreal dayWidth = content.width() / 7.0;
+    const QDate week = m_layoutWeek;
+
+    p.fillRect(viewport()->rect(), pal.color(QPalette::Base));
+
+    // Сетка часов и колонки дней
+    p.save();
+    p.setClipRect(content.adjusted(-kTimeColumnWidth, 0, 0, 0));
+    const int firstHour = scrollY / kHourHeight;
+    const int lastHour = qMin(23, (scrollY + content.height()) / kHourHeight);
+    p.setPen(pal.color(QPalette::Mid));
+    for (int hour = firstHour; hour <= lastHour; ++hour) {
+        const int y = content.top() + hour * kHourHeight - scrollY;
+        p.drawLine(content.left(), y, content.right(), y);
+        p.drawText(QRect(0, y + 2, kTimeColumnWidth - 6, kHourHeight), Qt::AlignRight | Qt::AlignTop,
+            QString("%1:00").arg(hour, 2, 10, QChar('0')));
+    }
+    for (int day = 0; day <= 7; ++day) {
+        const int x = content.left() + qRound(day * dayWidth);
+        p.drawLine(x, content.top(), x, content.bottom());
+    }
+    const QDate today = QDate::currentDate();
+    if (today >= week && today < week.addDays(7)) {
+        QColor highlight = pal.color(QPalette::Highlight);
+        highlight.setAlpha(25);
+        p.fillRect(QRectF(content.left() + week.daysTo(today) * dayWidth, content.top(),
+            dayWidth, content.height()), highlight);
+    }
+
+    // Блоки событий, пересекающие окно
+    const int visibleFrom = scrollY * 60 / kHourHeight;
+    const int visibleTo = (scrollY + content.height()) * 60 / kHourHeight + 1;
+    QFont blockFont = font();
+    blockFont.setPointSizeF(blockFont.pointSizeF() * 0.85);
+    p.setFont(blockFont);
+    const QFontMetrics metrics(blockFont);
+    p.setRenderHint(QPainter::Antialiasing);
+    for (const Block& block : m_blocks) {
+        if (block.endMinute <= visibleFrom || block.startMinute >= visibleTo) continue;
+
+        const qreal laneWidth = (dayWidth - 4) / block.lanes;
+        const qreal top = content.top() + block.startMinute * kHourHeight / 60.0 - scrollY;
+        const qreal height = qMax<qreal>(kMinBlockHeight,
+            (block.endMinute - block.startMinute) * kHourHeight / 60.0);
+        const QRectF rect(content.left() + block.day * dayWidth + 2 + block.lane * laneWidth,
+            top, laneWidth - 2, height - 1);
+
+        const QColor color = QColor::fromRgba(block.color);
+        p.setPen(Qt::NoPen);
+        p.setBrush(color);
+        p.drawRoundedRect(rect, 3, 3);
+        p.setPen(color.lightness() > 150 ? Qt::black : Qt::white);
+        const QRectF textRect = rect.adjusted(3, 1, -2, -1);
+        p.drawText(textRect, Qt::AlignLeft | Qt::AlignTop,
+            metrics.elidedText(block.time + " " + block.title, Qt::ElideRight, int(textRect.width())));
+    }
+    p.restore();
+
+    // Заголовок с днями недели поверх прокрутки
+    p.fillRect(QRect(0, 0, viewport()->width(), kHeaderHeight), pal.color(QPalette::Window));
+    p.setPen(pal.color(QPalette::WindowText));
+    const QLocale locale;
+    for (int day = 0; day < 7; ++day) {
+        const QDate date = week.addDays(day);
+        QFont headerFont = font();
+        headerFont.setBold(date == today);
+        p.setFont(headerFont);
+        p.drawText(QRectF(content.left() + day * dayWidth, 0, dayWidth, kHeaderHeight),
+            Qt::AlignCenter, locale.toString(date, "ddd d.MM"));
+    }
+}
+
+void WeekView::mousePressEvent(QMouseEvent* event)
+{
+    const QRect content = contentRect();
+    if (event->position().x() >= content.left() && content.width() > 0) {
+        const int day = int((event->position().x() - content.left()) * 7 / content.width());
+        emit dateClicked(weekStart().addDays(qBound(0, day, 6)));
+    }
+    QAbstractScrollArea::mousePressEvent(event);
+}
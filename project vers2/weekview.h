@@ -0,0 +1,66 @@
+#ifndef WEEKVIEW_H
+#define WEEKVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QDate>
+#include <QVector>
+#include "event.h"
+
+class EventStore;
+
+// Неделя по часам: семь колонок дней, вертикальная прокрутка по времени суток,
+// горизонтальная - по неделям. Раскладка строится одним запросом диапазона
+// для показанной недели, рисуются только блоки, попадающие в окно.
+class WeekView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit WeekView(QWidget* parent = nullptr);
+
+    void setEventStore(const EventStore* store);
+    // true, если источник сменился; сбросить кэш вида - забота вызывающего
+    bool setEventSource(Event::Source source);
+    void setAnchorDate(const QDate& date);
+    QDate weekStart() const;
+
+    void invalidate();
+    void invalidateDays(const QDate& from, const QDate& to);
+
+signals:
+    void dateClicked(const QDate& date);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    // Кусок события в пределах одного дня, время - в минутах от полуночи
+    struct Block {
+        int day;
+        int startMinute;
+        int endMinute;
+        int lane;
+        int lanes;
+        QRgb color;
+        QString title;
+        QString time;
+    };
+
+    const EventStore* m_store;
+    Event::Source m_source;
+    QDate m_anchor;
+
+    mutable QVector<Block> m_blocks;
+    mutable QDate m_layoutWeek;
+    mutable bool m_dirty;
+
+    void ensureLayout() const;
+    void assignLanes(QVector<Block>& blocks) const;
+    void updateScrollBars();
+    QRect contentRect() const;
+};
+
+#endif // WEEKVIEW_H